@@ -31,6 +31,7 @@ class AABB : public Hittable {
 
   // hit
   virtual void hit(const Ray& ray, HitResult& res) const override;
+  bool hit(const Ray& ray, float tMax) const;
 
   // merge
   static AABB merge(const AABB& aabb1, const AABB& aabb2);
@@ -12,6 +12,34 @@
 #include "Triangle.hpp"
 
 namespace spt {
+
+// shadow rays traced together with one occlusion-only traversal
+struct ShadowBatch {
+  std::vector<Ray> rays;
+  std::vector<float> tMaxs;
+  std::vector<char> occluded; // filled by BVH::occluded
+
+  size_t add(const Ray& ray, float tMax) {
+    rays.push_back(ray);
+    tMaxs.push_back(tMax);
+    return rays.size() - 1;
+  }
+  size_t size() const { return rays.size(); }
+  void clear() {
+    rays.clear();
+    tMaxs.clear();
+    occluded.clear();
+  }
+};
+
+// node of a flattened bvh, as stored in compiled scene files; children follow their parent
+struct BVHNodeRecord {
+  Vec3<float> minXYZ, maxXYZ;
+  uint32_t n;
+  uint32_t isLeaf;
+  uint32_t begin, end; // leaves: range of leaf objects, inner nodes: left and right child
+};
+
 class BVH : public Hittable {
  private:
   uint n;
@@ -19,6 +47,8 @@ class BVH : public Hittable {
   AABB aabb;
   bool isLeaf;
 
+  uint64_t occluded(ShadowBatch& batch, size_t base, uint64_t active) const;
+
  public:
   BVH(uint _n = 0);
   ~BVH() = default;
@@ -26,6 +56,19 @@ class BVH : public Hittable {
  public:
   // construct
   static std::shared_ptr<BVH> constructBVH( std::vector<std::shared_ptr<Hittable>>& objects, int beg, int end, int minCount=30);
+  // top level over bvhs built separately, e.g. one per mesh; inner nodes only, so batched
+  // traversal runs on through the meshes, and the size counts all their primitives.
+  // meshes are never split, so where their boxes overlap (interleaved or nested meshes)
+  // rays descend into several of them; a single bvh over all triangles traverses better
+  // there, the per-mesh builds trade that for building in parallel with loading
+  static std::shared_ptr<BVH> combine(std::vector<std::shared_ptr<Hittable>>& meshes, int beg, int end);
+
+  // pre-order nodes and the objects of the leaves in order, returns the index of this node
+  uint32_t flatten(std::vector<BVHNodeRecord>& nodes, std::vector<const Hittable*>& leafObjects) const;
+  // rebuild a flattened bvh without sorting, leaf objects given by their index in objects;
+  // the records must have been validated
+  static std::shared_ptr<BVH> restore(const BVHNodeRecord* nodes, const uint32_t* objectIds,
+                                      const std::vector<std::shared_ptr<Hittable>>& objects, uint32_t index = 0);
   
   // sort
   static void sortObjects(std::vector<std::shared_ptr<Hittable>>& objects, int beg, int end, int axis) ;
@@ -41,6 +84,10 @@ class BVH : public Hittable {
 
   // hit
   virtual void hit(const Ray &ray, HitResult &res) const override;
+
+  // occlusion
+  virtual bool occluded(const Ray &ray, float tMax) const override;
+  void occluded(ShadowBatch& batch) const;
 };
 
 }  // namespace spt
@@ -3,6 +3,7 @@
 
 #include <cmath>
 #include <iostream>
+#include <vector>
 
 #include "Ray.hpp"
 
@@ -30,7 +31,9 @@ class Camera {
   int getHeight() const;
   Vec3<float> getEye() const;
   Vec3<float> getLookAt() const;
+  Vec3<float> getUp() const;
   Vec3<float> getAxisZ() const;
+  float getFovy() const;
 
   // setter
   void setWidth(const int& w);
@@ -44,6 +47,28 @@ class Camera {
   void update();
 };
 
+// camera pose at one frame of an animation
+struct CameraKey {
+  int frame;
+  Vec3<float> eye, lookat, up;
+  float fovy;
+};
+
+// keyframed camera path, poses between keys are interpolated
+class CameraPath {
+ private:
+  std::vector<CameraKey> keys; // sorted by frame
+
+ public:
+  void addKey(const CameraKey& key);
+  bool empty() const { return keys.empty(); }
+  int getFirstFrame() const { return keys.empty() ? 0 : keys.front().frame; }
+  int getLastFrame() const { return keys.empty() ? -1 : keys.back().frame; }
+
+  // catmull-rom through the eye and lookat keys, linear up and fovy, clamped outside the keys
+  void apply(Camera& camera, float frame) const;
+};
+
 }  // namespace spt
 
 #endif
\ No newline at end of file
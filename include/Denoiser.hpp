@@ -0,0 +1,51 @@
+#ifndef SRE_DENOISER_HPP
+#define SRE_DENOISER_HPP
+
+#include <algorithm>
+#include <vector>
+
+#include "Utils.hpp"
+
+namespace spt {
+
+class ThreadPool;
+
+// guides from the first visible surface of each pixel, misses have zero normal and depth
+struct FeatureBuffer {
+  int width = 0, height = 0;
+  std::vector<Vec3<float>> albedo;
+  std::vector<Vec3<float>> normal;
+  std::vector<float> depth;
+
+  FeatureBuffer() = default;
+  FeatureBuffer(int w, int h)
+      : width(w), height(h), albedo(w * h, Vec3<float>(1, 1, 1)), normal(w * h, Vec3<float>(0, 0, 0)), depth(w * h, 0.f) {}
+};
+
+// edge-avoiding a-trous wavelet filter: a 5x5 B3 spline kernel dilated by 2^i
+// over i iterations, taps weighted by luminance against the pixel's input noise
+// level, normal and depth; albedo is divided out so texture detail survives
+class Denoiser {
+ private:
+  int iterations; // at most MAX_ITERATIONS
+  float sigmaLuminance; // in standard deviations of the pixel's noise
+  float sigmaNormal; // exponent of the normal cosine
+  float sigmaDepth; // relative depth difference per tap step
+
+ public:
+  // taps 2^16 pixels apart already span any image, more iterations would only overflow the step
+  static constexpr int MAX_ITERATIONS = 16;
+
+  explicit Denoiser(int _iterations = 5, float _sigmaLuminance = 4.f, float _sigmaNormal = 128.f, float _sigmaDepth = 0.05f)
+      : iterations(std::clamp(_iterations, 0, MAX_ITERATIONS)), sigmaLuminance(_sigmaLuminance), sigmaNormal(_sigmaNormal), sigmaDepth(_sigmaDepth) {}
+
+  // filter colors in place, variances hold the luminance variance of each pixel mean;
+  // returns the noise variance reduction of the same weights applied to independent
+  // noise, optimistic since the edge stops keep noise that differs from its neighbours
+  float denoise(std::vector<Vec3<float>>& colors, const std::vector<float>& variances, const FeatureBuffer& features,
+                ThreadPool& pool) const;
+};
+
+}  // namespace spt
+
+#endif
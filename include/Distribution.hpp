@@ -0,0 +1,75 @@
+#ifndef SRE_DISTRIBUTION_HPP
+#define SRE_DISTRIBUTION_HPP
+
+#include <vector>
+
+#include "Utils.hpp"
+
+namespace spt {
+
+// Walker/Vose alias table: O(n) build, O(1) sampling of a discrete distribution
+class AliasTable {
+ private:
+  std::vector<float> probs; // normalized probability of each entry
+  std::vector<float> cutoffs; // keep own index if u < cutoff
+  std::vector<uint> aliases; // otherwise jump to alias
+  float total;
+
+ public:
+  AliasTable() : total(0.f) {}
+  AliasTable(const std::vector<float>& weights);
+  ~AliasTable() = default;
+
+  // getter
+  size_t size() const { return probs.size(); }
+  bool empty() const { return probs.empty() || total <= 0.f; }
+  float getTotal() const { return total; }
+  float getProb(uint idx) const { return probs[idx]; }
+
+  // sample an index with its probability
+  uint sample(float u1, float u2, float* prob = nullptr) const;
+  uint sample(float* prob = nullptr) const { return sample(rand(1.f), rand(1.f), prob); }
+};
+
+// piecewise constant 1D distribution over [0, 1), sampled by inverting its CDF
+class Distribution1D {
+ private:
+  std::vector<float> func;
+  std::vector<float> cdf; // size + 1 entries
+  float integral;
+
+ public:
+  Distribution1D() : integral(0.f) {}
+  Distribution1D(const float* f, int n);
+  ~Distribution1D() = default;
+
+  // getter
+  size_t size() const { return func.size(); }
+  float getIntegral() const { return integral; }
+  float getFunc(int idx) const { return func[idx]; }
+
+  // sample a point in [0, 1) with its density
+  float sample(float u, float* pdf = nullptr, int* offset = nullptr) const;
+};
+
+// piecewise constant 2D distribution over [0, 1)^2: marginal on v, conditional on u
+class Distribution2D {
+ private:
+  std::vector<Distribution1D> conditionals;
+  Distribution1D marginal;
+
+ public:
+  Distribution2D() = default;
+  Distribution2D(const float* f, int nu, int nv);
+  ~Distribution2D() = default;
+
+  bool empty() const { return conditionals.empty() || marginal.getIntegral() <= 0.f; }
+
+  // sample (u, v) with its density
+  Vec2<float> sample(float u0, float u1, float* pdf) const;
+  float pdf(const Vec2<float>& p) const;
+};
+
+}  // namespace spt
+
+#endif
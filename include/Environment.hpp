@@ -0,0 +1,45 @@
+#ifndef SRE_ENVIRONMENT_HPP
+#define SRE_ENVIRONMENT_HPP
+
+#include <string>
+#include <vector>
+
+#include "Distribution.hpp"
+#include "Utils.hpp"
+
+namespace spt {
+
+// infinitely distant light from an equirectangular HDR map, +y is up
+class Environment {
+ private:
+  int width, height;
+  std::vector<Vec3<float>> pixels; // linear radiance
+  float scale;
+  Distribution2D distribution; // luminance * sin(theta) over (u, v)
+
+  Vec3<float> lookup(const Vec2<float>& uv) const;
+
+ public:
+  Environment(const std::string& imgName, float _scale = 1.f);
+  ~Environment() = default;
+
+  // getter
+  bool isValid() const { return !pixels.empty(); }
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+
+  // direction <-> map coordinates
+  static Vec2<float> toUV(const Vec3<float>& dir);
+  static Vec3<float> toDirection(const Vec2<float>& uv);
+
+  // radiance arriving along -dir, i.e. seen when looking towards dir
+  Vec3<float> getRadiance(const Vec3<float>& dir) const;
+
+  // importance sample a direction, returns radiance and solid angle pdf
+  Vec3<float> sample(Vec3<float>& dir, float& pdf) const;
+  float pdf(const Vec3<float>& dir) const;
+};
+
+}  // namespace spt
+
+#endif
@@ -0,0 +1,84 @@
+#ifndef SRE_FILM_HPP
+#define SRE_FILM_HPP
+
+#include <string>
+#include <vector>
+
+#include "Utils.hpp"
+
+namespace spt {
+
+// float rgb accumulation buffer with per-pixel sample counts, so samples
+// can be added in passes and the state saved to and resumed from disk; a film
+// may cover only a window of the frame, as partials of distributed renders do,
+// rows and columns are frame coordinates either way
+class Film {
+ private:
+  int width, height;
+  int originX, originY; // window position in the frame
+  int frameWidth, frameHeight;
+
+  int index(int row, int col) const { return (row - originY) * width + (col - originX); }
+  std::vector<Vec3<float>> sums; // sum of radiance samples
+  // luminance sums for the variance, in double as the difference of the two cancels in float
+  std::vector<double> lumSums; // sum of sample luminance
+  std::vector<double> lumSqSums; // sum of squared sample luminance
+  std::vector<uint32_t> counts; // number of samples
+
+ public:
+  Film() : width(0), height(0), originX(0), originY(0), frameWidth(0), frameHeight(0) {}
+  Film(int w, int h);
+  // w x h window at (x, y) of a frameW x frameH frame
+  Film(int w, int h, int x, int y, int frameW, int frameH);
+  ~Film() = default;
+
+  // getter
+  int getWidth() const { return width; }
+  int getHeight() const { return height; }
+  int getOriginX() const { return originX; }
+  int getOriginY() const { return originY; }
+  int getFrameWidth() const { return frameWidth; }
+  int getFrameHeight() const { return frameHeight; }
+  uint32_t getCount(int row, int col) const { return counts[index(row, col)]; }
+  uint32_t getMinCount() const;
+  uint64_t getTotalCount() const;
+  Vec3<float> getPixel(int row, int col) const;
+  // variance of the pixel's mean luminance, a single sample counts as 100% relative error
+  float getVariance(int row, int col) const;
+  // relative standard error of the pixel's mean luminance
+  float getError(int row, int col) const;
+  // mean radiance of every pixel in the window
+  std::vector<Vec3<float>> getImage() const;
+
+  // add n samples whose radiance sums to sum, luminance to lum and squared luminance to lumSq,
+  // one writer per pixel
+  void add(int row, int col, const Vec3<float>& sum, double lum, double lumSq, uint32_t n) {
+    int idx = index(row, col);
+    sums[idx] += sum;
+    lumSums[idx] += lum;
+    lumSqSums[idx] += lumSq;
+    counts[idx] += n;
+  }
+
+  void clear();
+
+  // window of w x h pixels at frame position (x, y), clipped to this film
+  Film crop(int x, int y, int w, int h) const;
+  // add the samples of a window of the same frame, false if it does not fit
+  bool merge(const Film& part);
+
+  // gamma corrected 8-bit rgb
+  std::vector<uint8_t> toImage() const { return toImage(getImage()); }
+  static std::vector<uint8_t> toImage(std::vector<Vec3<float>> colors);
+
+  // binary checkpoint, written to a temporary file and renamed into place
+  bool save(const std::string& fileName) const;
+  // false if missing, corrupt or of a different size or window
+  bool load(const std::string& fileName);
+  // take size and window from the file
+  bool loadPartial(const std::string& fileName);
+};
+
+}  // namespace spt
+
+#endif
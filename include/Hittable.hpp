@@ -7,6 +7,10 @@
 
 namespace spt {
 
+// hits closer than this to the ray origin are the surface the ray starts on; shadow rays stop
+// this short of the light for the same reason
+constexpr float RAY_OFFSET = 0.05f;
+
 struct HitResult {
   bool hit;
   int id;
@@ -14,9 +18,10 @@ struct HitResult {
   Vec3<float> point;
   Vec2<float> uv;
   Vec3<float> normal;
-  Material material;
+  uint mtlId; // index into the scene's MaterialTable
+  float footprint; // ray cone width in uv units, selects the mip level
 
-  HitResult() : hit(false), distance(-1) {}
+  HitResult() : hit(false), distance(-1), footprint(0.f) {}
 };
 
 class Hittable {
@@ -35,6 +40,13 @@ class Hittable {
 
   // hit
   virtual void hit(const Ray& ray, HitResult& res) const = 0;
+
+  // any hit closer than tMax, no shading info
+  virtual bool occluded(const Ray& ray, float tMax) const {
+    HitResult res;
+    hit(ray, res);
+    return res.hit && res.distance < tMax;
+  }
 };
 
 }  // namespace spt
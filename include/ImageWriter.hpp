@@ -0,0 +1,49 @@
+#ifndef SRE_IMAGE_WRITER_HPP
+#define SRE_IMAGE_WRITER_HPP
+
+#include <cstdint>
+#include <string>
+
+#include "Utils.hpp"
+
+namespace spt {
+
+enum ImageFormat {
+  IMAGE_PNG, // 8-bit sRGB, written once from the whole film
+  IMAGE_PFM, // linear float rgb, rows bottom to top
+  IMAGE_EXR, // linear float rgb, uncompressed scanlines
+  IMAGE_FILM, // film with sample counts, partial of a distributed render
+};
+
+// linear float image file laid out in full when opened, so rows of finished
+// tiles can be written concurrently at fixed offsets with pwrite
+class ImageWriter {
+ private:
+  int fd;
+  int width, height;
+  ImageFormat format;
+  int64_t dataOffset; // first pixel byte
+
+  bool writeAt(const void* data, size_t bytes, int64_t offset) const;
+
+ public:
+  ImageWriter() : fd(-1), width(0), height(0), format(IMAGE_PNG), dataOffset(0) {}
+  ~ImageWriter();
+
+  ImageWriter(const ImageWriter&) = delete;
+  ImageWriter& operator=(const ImageWriter&) = delete;
+
+  // format by file extension, png unless .pfm, .exr or .sptf
+  static ImageFormat getFormat(const std::string& fileName);
+
+  // write the header and size the file, format must be pfm or exr
+  bool open(const std::string& fileName, int w, int h, ImageFormat f);
+  bool isOpen() const { return fd >= 0; }
+  // count pixels of row starting at col, thread-safe for disjoint spans
+  bool writeRow(int row, int col, const Vec3<float>* pixels, int count) const;
+  bool close();
+};
+
+}  // namespace spt
+
+#endif
@@ -1,73 +1,231 @@
 #ifndef SRE_LIGHT_HPP
 #define SRE_LIGHT_HPP
 
+#include<cfloat>
 #include<vector>
 #include<map>
 #include<memory>
+#include<unordered_map>
 
 #include "Triangle.hpp"
 #include "BVH.hpp"
+#include "Distribution.hpp"
+#include "Environment.hpp"
+#include "LightBVH.hpp"
 
 namespace spt
 {
+    enum LightSampling {
+        LIGHT_SAMPLE_POWER, // alias tables over groups and triangles
+        LIGHT_SAMPLE_BVH, // light hierarchy, importance by estimated contribution
+    };
+
+    struct LightSample {
+        Vec3<float> dir; // P -> light, zero if occluded
+        float distance;
+        float pdf; // solid angle measure
+        Vec3<float> emission;
+
+        LightSample() : dir(0.f, 0.f, 0.f), distance(0.f), pdf(0.f), emission(0.f, 0.f, 0.f) {}
+    };
+
     class Light {
         std::vector<std::shared_ptr<Triangle>> lights;
+        std::vector<float> lightPowers; // light index -> area * luminance
+        std::vector<Vec3<float>> emissions; // light index -> emitted radiance
         std::map<std::string, ulong> mtlnames; // mtlname -> group index
         std::vector<std::vector<ulong>> groups; // group index -> light index
         std::vector<float> areas; // group index -> group area sum
+        std::vector<float> powers; // group index -> sum of area * luminance
+        std::vector<std::pair<ulong, ulong>> positions; // light index -> (group index, index in group)
+        std::unordered_map<size_t, ulong> ids; // object id -> light index
+
+        AliasTable groupTable; // group index, weighted by power
+        std::vector<AliasTable> triangleTables; // group index -> light index in group, weighted by area
+
+        LightSampling sampling = LIGHT_SAMPLE_POWER;
+        LightBVH bvh;
+
+        std::shared_ptr<Environment> env;
+
+        // probability of sampling the environment instead of the emissive triangles
+        float envProb() const {
+            if (env == nullptr || !env->isValid()) {
+                return 0.f;
+            }
+            return lights.empty() ? 1.f : 0.5f;
+        }
+
+        // pick a light index and its selection probability
+        bool pick(const Vec3<float>& p, const Vec3<float>& n, ulong& lidx, float& prob) const {
+            if (sampling == LIGHT_SAMPLE_BVH) {
+                uint idx;
+                if (!bvh.sample(p, n, rand(1.f), idx, prob)) {
+                    return false;
+                }
+                lidx = idx;
+                return true;
+            }
+
+            if (groupTable.empty()) {
+                return false;
+            }
+            // pick group by power, then triangle by area
+            float gprob = 0.f, lprob = 0.f;
+            ulong gidx = groupTable.sample(&gprob);
+            lidx = groups[gidx][triangleTables[gidx].sample(&lprob)];
+            prob = gprob * lprob;
+            return true;
+        }
+
+        // selection probability of light index lidx
+        float pickProb(const Vec3<float>& p, const Vec3<float>& n, ulong lidx) const {
+            if (sampling == LIGHT_SAMPLE_BVH) {
+                return bvh.pmf(p, n, lidx);
+            }
+
+            if (groupTable.empty()) {
+                return 0.f;
+            }
+            auto [gidx, pos] = positions[lidx];
+            return groupTable.getProb(gidx) * triangleTables[gidx].getProb(pos);
+        }
+
+        // random point on light lidx seen from p, visibility not tested
+        bool samplePoint(const Vec3<float>& p, ulong lidx, float prob, LightSample& ls) const {
+            const auto& triangle = lights[lidx];
+            Vec3<float> pp = triangle->getRandomPoint();
+            Vec3<float> dir = pp - p;
+            float dis = dir.length();
+            if (dis < EPSILON) {
+                return false;
+            }
+            dir /= dis;
+
+            float cosLight = ::fabsf(dot(triangle->getNormal(), dir));
+            if (cosLight < EPSILON) {
+                return false;
+            }
+
+            // convert area density to solid angle density
+            ls.dir = dir;
+            ls.distance = dis;
+            ls.pdf = prob / triangle->getSize() * dis * dis / cosLight;
+            ls.emission = emissions[lidx];
+            return true;
+        }
 
         public:
-        void setLight(std::shared_ptr<Triangle> triangle) {
+        void setSampling(LightSampling s) { sampling = s; }
+        LightSampling getSampling() const { return sampling; }
+        size_t getSize() const { return lights.size(); }
+        const std::shared_ptr<Triangle>& getTriangle(ulong lidx) const { return lights[lidx]; }
+
+        void setEnvironment(const std::shared_ptr<Environment>& e) { env = e; }
+        bool hasEnvironment() const { return env != nullptr && env->isValid(); }
+        Vec3<float> getEnvironmentRadiance(const Vec3<float>& dir) const {
+            return hasEnvironment() ? env->getRadiance(dir) : Vec3<float>(0.f, 0.f, 0.f);
+        }
+
+        void setLight(std::shared_ptr<Triangle> triangle, const Vec3<float>& emission, const std::string& name) {
             // basic info
-            Material mtl = triangle->getMaterial();
-            assert(mtl.isEmissive());
-            std::string name = mtl.getName();
             float area = triangle->getSize();
+            float power = area * luminance(emission);
 
             // group based on mtl
             if (mtlnames.find(name) == mtlnames.end()) {
                 mtlnames[name] = groups.size();
+                positions.emplace_back(groups.size(), 0);
                 groups.push_back({lights.size()});
                 areas.push_back(area);
+                powers.push_back(power);
             } else {
                 int gidx = mtlnames[name];
+                positions.emplace_back(gidx, groups[gidx].size());
                 groups[gidx].push_back(lights.size());
                 areas[gidx] += area;
+                powers[gidx] += power;
             }
 
+            ids[triangle->getId()] = lights.size();
             lights.push_back(triangle);
+            lightPowers.push_back(power);
+            emissions.push_back(emission);
+        }
+
+        // build sampling tables, must be called after all lights are set
+        void build() {
+            groupTable = AliasTable(powers);
+
+            triangleTables.clear();
+            for (const auto& group : groups) {
+                std::vector<float> weights;
+                for (ulong lidx : group) {
+                    weights.push_back(lights[lidx]->getSize());
+                }
+                triangleTables.emplace_back(weights);
+            }
+
+            if (sampling == LIGHT_SAMPLE_BVH) {
+                bvh.build(lights, lightPowers);
+            }
         }
 
-        std::vector<std::pair<Vec3<float>, float>> sampleAll(const std::shared_ptr<BVH>& scene, const Vec3<float>& p) {
-            std::vector<std::pair<Vec3<float>, float>> ret;
-            
-            for (int gidx = 0; gidx < groups.size(); gidx++) {
-                int lidx = groups[gidx][rand(groups[gidx].size() - 1)];
-                
-                Vec3<float> pp = lights[lidx]->getRandomPoint();
-                Vec3<float> dir = normalize(pp - p);
-                float pdf = 0.f;
-
-                Ray ray(p, dir);
-                HitResult res;
-                scene->hit(ray, res);
-                
-                if (!res.hit || res.material.getName() != lights[lidx]->getMaterial().getName()) {
-                    dir = Vec3<float>(0, 0, 0);
-                } else {
-                    float area = areas[gidx];
-                    pdf = 1 / area;
+        // one sample per light group from p, appended together with its shadow ray,
+        // so samples[k] of this call is tested by the k-th ray it added to batch
+        void sampleAll(const Vec3<float>& p, std::vector<LightSample>& samples, ShadowBatch& batch) const {
+            for (ulong gidx = 0; gidx < groups.size(); gidx++) {
+                if (triangleTables[gidx].empty()) {
+                    continue;
+                }
+
+                // area-weighted triangle selection gives a uniform density over the group
+                float prob = 0.f;
+                ulong lidx = groups[gidx][triangleTables[gidx].sample(&prob)];
+
+                LightSample ls;
+                if (!samplePoint(p, lidx, prob, ls)) {
+                    continue;
                 }
+                samples.push_back(ls);
+                batch.add(Ray(p, ls.dir), ls.distance - RAY_OFFSET);
+            }
+
+            // environment counts as one more group
+            if (hasEnvironment()) {
+                LightSample ls;
+                ls.emission = env->sample(ls.dir, ls.pdf);
+                ls.distance = FLT_MAX;
+                if (ls.pdf > 0.f) {
+                    samples.push_back(ls);
+                    batch.add(Ray(p, ls.dir), FLT_MAX);
+                }
+            }
+        }
+
+        // one visible sample per light group from p into samples, occluded ones have zero pdf;
+        // batch is scratch, both are reused by the caller so no allocation per hit
+        void sampleAll(const std::shared_ptr<BVH>& scene, const Vec3<float>& p,
+                       std::vector<LightSample>& samples, ShadowBatch& batch) const {
+            samples.clear();
+            batch.clear();
+            sampleAll(p, samples, batch);
 
-                ret.emplace_back(dir, pdf);
+            scene->occluded(batch);
+            for (size_t i = 0; i < samples.size(); i++) {
+                if (batch.occluded[i]) {
+                    samples[i] = LightSample();
+                }
             }
-            return ret;
         }
 
-        std::pair<Vec3<float>, float> sample(const std::shared_ptr<BVH>& scene, const Vec3<float>& p) {
-            ulong gidx = rand(groups.size() - 1);
-            ulong lidx = groups[gidx][rand(groups[gidx].size() - 1)];
-            
+        std::pair<Vec3<float>, float> sample(const std::shared_ptr<BVH>& scene, const Vec3<float>& p, const Vec3<float>& n = Vec3<float>(0.f, 0.f, 0.f)) {
+            ulong lidx;
+            float prob = 0.f;
+            if (!pick(p, n, lidx, prob)) {
+                return {Vec3(0.f, 0.f, 0.f), 0.f};
+            }
+
             Vec3<float> pp = lights[lidx]->getRandomPoint();
             Vec3<float> dir = normalize(pp - p);
             float pdf = 0.f;
@@ -75,18 +233,83 @@ namespace spt
             Ray ray(p, dir);
             HitResult res;
             scene->hit(ray, res);
-            
-            if (!res.hit || res.material.getName() != lights[lidx]->getMaterial().getName()) {
+
+            // any triangle of the same light group counts as visible
+            auto itr = res.hit ? ids.find(res.id) : ids.end();
+            if (itr == ids.end() || positions[itr->second].first != positions[lidx].first) {
                 dir = Vec3(0.f, 0.f, 0.f);
             } else {
-                float area = areas[gidx];
-                pdf = 1 / area;
+                // area density: P(triangle) / triangle area
+                pdf = prob / lights[lidx]->getSize();
             }
 
             return {dir, pdf};
         }
+
+        // sample a visible point on the lights for next event estimation at p
+        LightSample sampleLi(const std::shared_ptr<BVH>& scene, const Vec3<float>& p, const Vec3<float>& n) const {
+            LightSample ls;
+
+            // environment
+            float pe = envProb();
+            if (pe > 0.f && rand(1.f) < pe) {
+                ls.emission = env->sample(ls.dir, ls.pdf);
+                ls.distance = FLT_MAX;
+                if (ls.pdf <= 0.f || scene->occluded(Ray(p, ls.dir), FLT_MAX)) {
+                    return LightSample();
+                }
+                ls.pdf *= pe;
+                return ls;
+            }
+
+            ulong lidx;
+            float prob = 0.f;
+            if (!pick(p, n, lidx, prob) || !samplePoint(p, lidx, prob * (1 - pe), ls)) {
+                return LightSample();
+            }
+
+            // visibility
+            if (scene->occluded(Ray(p, ls.dir), ls.distance - RAY_OFFSET)) {
+                return LightSample();
+            }
+            return ls;
+        }
+
+        // solid angle density of sampleLi (or of sampleAll if allGroups) choosing point pp on object id from p
+        float pdf(const Vec3<float>& p, const Vec3<float>& n, size_t id, const Vec3<float>& pp, bool allGroups = false) const {
+            auto itr = ids.find(id);
+            if (itr == ids.end()) {
+                return 0.f;
+            }
+
+            const auto& triangle = lights[itr->second];
+            Vec3<float> dir = pp - p;
+            float dis2 = dot(dir, dir);
+            float cosLight = ::fabsf(dot(triangle->getNormal(), normalize(dir)));
+            if (cosLight < EPSILON) {
+                return 0.f;
+            }
+
+            float prob = 0.f;
+            if (allGroups) {
+                auto [gidx, pos] = positions[itr->second];
+                prob = triangleTables[gidx].getProb(pos);
+            } else {
+                prob = pickProb(p, n, itr->second) * (1 - envProb());
+            }
+
+            return prob / triangle->getSize() * dis2 / cosLight;
+        }
+
+        // solid angle density of sampleLi (or of sampleAll if allGroups) choosing environment direction dir
+        float pdfEnvironment(const Vec3<float>& dir, bool allGroups = false) const {
+            if (!hasEnvironment()) {
+                return 0.f;
+            }
+            return (allGroups ? 1.f : envProb()) * env->pdf(dir);
+        }
     };
 } // namespace spt
 
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,67 @@
+#ifndef SRE_LIGHTBVH_HPP
+#define SRE_LIGHTBVH_HPP
+
+#include <memory>
+#include <vector>
+
+#include "AABB.hpp"
+#include "Triangle.hpp"
+#include "Utils.hpp"
+
+namespace spt {
+
+// bounds of a set of emitters: position, power and emission directions
+struct LightBounds {
+  AABB aabb;
+  float phi; // power
+  Vec3<float> w; // cone axis
+  float cosThetaO; // spread of normals around w
+  float cosThetaE; // emission falloff around each normal (pi/2 for area lights)
+
+  LightBounds() : phi(0.f), w(0.f, 0.f, 1.f), cosThetaO(1.f), cosThetaE(0.f) {}
+  LightBounds(const AABB& _aabb, float _phi, const Vec3<float>& _w, float _cosThetaO, float _cosThetaE)
+      : aabb(_aabb), phi(_phi), w(_w), cosThetaO(_cosThetaO), cosThetaE(_cosThetaE) {}
+
+  // estimated contribution to point p with normal n (n may be zero), emitters are two-sided
+  float importance(const Vec3<float>& p, const Vec3<float>& n) const;
+
+  static LightBounds merge(const LightBounds& a, const LightBounds& b);
+};
+
+struct LightBVHNode {
+  LightBounds bounds;
+  uint index; // leaf: light index, interior: second child index (first child is next node)
+  bool isLeaf;
+};
+
+class LightBVH {
+ private:
+  // sah splits up to this depth, median splits below add at most 32 levels for 2^32 lights
+  static constexpr int MAX_SAH_DEPTH = 32;
+
+  std::vector<LightBVHNode> nodes;
+  std::vector<uint64_t> trails; // light index -> bit trail from root (0 left, 1 right)
+
+  uint build(std::vector<std::pair<uint, LightBounds>>& items, int beg, int end, uint64_t trail, int depth);
+
+ public:
+  LightBVH() = default;
+  ~LightBVH() = default;
+
+  // construct from emissive triangles and their power
+  void build(const std::vector<std::shared_ptr<Triangle>>& lights, const std::vector<float>& powers);
+
+  // getter
+  bool empty() const { return nodes.empty(); }
+  uint getNodeCount() const { return nodes.size(); }
+
+  // sample a light index in O(log n), returns false if no light contributes
+  bool sample(const Vec3<float>& p, const Vec3<float>& n, float u, uint& lidx, float& prob) const;
+
+  // probability of choosing light lidx at point p
+  float pmf(const Vec3<float>& p, const Vec3<float>& n, uint lidx) const;
+};
+
+}  // namespace spt
+
+#endif
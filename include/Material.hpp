@@ -2,6 +2,8 @@
 #define SRE_MATERIAL_HPP
 
 #include <string>
+#include <type_traits>
+#include <vector>
 
 #include "Texture.hpp"
 
@@ -29,27 +31,40 @@ enum BSDFType {
   BSDF_BLINN_PHONG = 1 << 7,
 };
 
-class Material {
-  std::string name;
-  
-  // light property
-  bool emissive;
-  Vec3<float> emission;
+enum SampleMode {
+  SAMPLE_GGX,
+  SAMPLE_COSINE,
+};
+
+// compact shading record baked at load, the first cache line holds everything
+// the microfacet kernels read, phong and emission data follow in the second
+class alignas(64) Material {
+  // bsdf kernels specialised on surface type, illumination model and transmission
+  struct BSDFKernel {
+    Vec3<float> (Material::*bsdf)(const Vec3<float>&, const Vec3<float>&, const Vec3<float>&, const Vec2<float>&, float) const;
+    std::pair<Vec3<float>, float> (Material::*scatter)(const Vec3<float>&, const Vec3<float>&) const;
+    float (Material::*pdf)(const Vec3<float>&, const Vec3<float>&, const Vec3<float>&) const;
+    // 8 directions at once, null where there is no 8-lane form
+    void (Material::*bsdf8)(const Vec3<float>&, const Vec3<float>&, const Vec3<float>*, const Vec2<float>&, Vec3<float>*, float) const;
+  };
+  const BSDFKernel* kernel = nullptr; // resolved once from type
+
+  // shared property
+  Texture* albedo;
 
   // microfacet property
   Vec3<float> diffuse; // Kd
   // m-r workflow
   float metallic;   // Pm (0 = dielectric, 1 = metal)
   float roughness;  // Pr (0 = perfectly smooth, 1 = fully rough)
-  // s-g workflow
-  Vec3<float> specular; // Ks
-  float glossiness; // sheen
-  
-  // phong/phong-blinn property
-  float shininess; // Ns
+
+  // derived constants
+  float alpha2; // (roughness^2)^2 for GGX
+  float k; // Smith-Schlick k
+  float f0; // dielectric part of F0, 0.04 * (1 - metallic)
+  float f0Eta; // ((ior - 1) / (ior + 1))^2, same from either side
 
   // shared property
-  Texture* albedo;
   float transparency; // Tr or d (0 = opaque, 1 = fully transparent)
   float ior; // Ni
 
@@ -58,38 +73,108 @@ class Material {
   static uint surfMask; // bsdf surface type mask
   static uint illuMask; // bsdf illumimation model mask
 
-  static float GGX_D(float NdotH, float roughness);
+  // s-g workflow
+  Vec3<float> specular; // Ks
+
+  // phong/phong-blinn property
+  float shininess; // Ns
+
+  // light property
+  Vec3<float> emission;
+  bool emissive;
+
+  static const BSDFKernel* resolveKernel(uint type);
+  template <uint Surf> static const BSDFKernel* selectKernel(uint illuType, bool transmissive);
+  template <uint Surf, uint Illu> static const BSDFKernel* selectKernel(bool transmissive);
+  template <uint Surf, uint Illu, bool Trans> static constexpr auto selectKernel8() -> decltype(BSDFKernel::bsdf8);
+
+  template <uint Surf, uint Illu, bool Trans>
+  Vec3<float> bsdfKernel(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec2<float>& UV, float footprint) const;
+  template <uint Surf, uint Illu, bool Trans>
+  void bsdfKernel8(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float>* L, const Vec2<float>& UV, Vec3<float>* out, float footprint) const;
+  template <uint Surf, bool Trans>
+  std::pair<Vec3<float>, float> scatterKernel(const Vec3<float> &V, const Vec3<float> &N) const;
+  template <uint Surf, bool Trans>
+  float pdfKernel(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const;
+
+  static float GGX_D(float NdotH, float alpha2);
   static Vec3<float> Fresnel_Schlick(float cosTheta, const Vec3<float>& F0);
-  static float Smith_G(float NdotV, float NdotL, float roughness);
+  static float Smith_G(float NdotV, float NdotL, float k);
 
-  Vec3<float> brdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV) const;
+  template <uint Surf, uint Illu>
+  Vec3<float> brdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV, float footprint) const;
+  template <uint Surf>
   Vec3<float> btdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV, float eta) const;
 
+  template <uint Surf>
   std::pair<Vec3<float>, float> reflect(const Vec3<float> &V, const Vec3<float> &N) const;
+  template <uint Surf>
   std::pair<Vec3<float>, float> transmit(const Vec3<float> &V, const Vec3<float> &N) const;
 
-  Vec3<float> sample(const Vec3<float> &V, const Vec3<float> &N, const std::string& mode) const;
+  template <uint Surf>
+  float pdfReflect(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const;
+  template <uint Surf>
+  float pdfTransmit(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const;
+
+  template <SampleMode Mode>
+  Vec3<float> sample(const Vec3<float> &V, const Vec3<float> &N) const;
 public:
-  Material() = default;
+  Material();
 
   ~Material() = default;
   
   Material(const tinyobj::material_t& mtl, const std::string& dir, uint illuType);
 
   bool isEmissive() const;
+  bool isSpecular() const;
   
   void setEmission(Vec3<float> e);
 
-  std::string getName() const;
+  // copy without kernel and texture pointers, as stored in compiled scene files
+  Material unlinked() const;
+  // restore the pointers of a stored copy, texture may be null
+  void link(Texture* texture);
+
   uint getType() const;
   Vec3<float> getEmission() const;
-  Vec3<float> getBaseColor(Vec2<float> uv) const;
+  Vec3<float> getBaseColor(Vec2<float> uv, float footprint = 0.f) const;
 
-  // evaluate BSDF
-  Vec3<float> bsdf(const Vec3<float> &wi, const Vec3<float> &n, const Vec3<float> &wo, const Vec2<float>& uv) const;
+  // evaluate BSDF, footprint filters the albedo texture
+  Vec3<float> bsdf(const Vec3<float> &wi, const Vec3<float> &n, const Vec3<float> &wo, const Vec2<float>& uv, float footprint = 0.f) const;
+
+  // evaluate BSDF for count directions wo at the same shading point, 8 at a time
+  void bsdf(const Vec3<float> &wi, const Vec3<float> &n, const Vec3<float>* wo, size_t count, const Vec2<float>& uv, Vec3<float>* out, float footprint = 0.f) const;
 
   // sample direction and corresponding pdf
   std::pair<Vec3<float>, float> scatter(const Vec3<float> &wi, const Vec3<float> &n) const;
+
+  // evaluate pdf of scatter sampling direction wo
+  float pdf(const Vec3<float> &wi, const Vec3<float> &n, const Vec3<float> &wo) const;
+};
+
+static_assert(std::is_trivially_copyable<Material>::value, "Material must stay a POD-like record");
+static_assert(sizeof(Material) == 128, "Material must span exactly two cache lines");
+
+// contiguous material records, names kept apart from the hot data
+class MaterialTable {
+ private:
+  std::vector<Material> materials;
+  std::vector<std::string> names;
+  std::vector<std::string> textures; // albedo texture relative to the scene dir, for compiled scenes
+
+ public:
+  uint add(const Material& mtl, const std::string& name, const std::string& texture = "") {
+    materials.push_back(mtl);
+    names.push_back(name);
+    textures.push_back(texture);
+    return materials.size() - 1;
+  }
+
+  // getter
+  size_t size() const { return materials.size(); }
+  const Material& operator[](uint id) const { return materials[id]; }
+  const std::string& getName(uint id) const { return names[id]; }
+  const std::string& getTexture(uint id) const { return textures[id]; }
 };
 }  // namespace spt
 
@@ -0,0 +1,54 @@
+#ifndef SRE_OBJ_PARSER_HPP
+#define SRE_OBJ_PARSER_HPP
+
+#include <cstddef>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <tiny_obj_loader.h>
+
+namespace spt {
+
+class ThreadPool;
+struct ObjChunk;
+
+// obj reader for large files: the file is memory-mapped, split into line-aligned
+// chunks parsed independently, and merged into what tinyobj::LoadObj returns with
+// triangulation on; relative indices, usemtl and groups that cross chunk borders
+// are resolved in the merge, materials come from the mtllib files via tinyobj
+class ObjParser {
+ private:
+  int fd;
+  const char* data;
+  size_t size;
+  std::vector<std::unique_ptr<ObjChunk>> chunks;
+
+ public:
+  ObjParser();
+  ~ObjParser();
+
+  ObjParser(const ObjParser&) = delete;
+  ObjParser& operator=(const ObjParser&) = delete;
+
+  // map the file and split it into chunks of about chunkBytes
+  bool open(const std::string& fileName, size_t chunkBytes = size_t(4) << 20);
+  size_t getChunkCount() const { return chunks.size(); }
+  size_t getFileSize() const { return size; }
+
+  // thread-safe for distinct chunks
+  void parseChunk(size_t i);
+
+  // merge the parsed chunks, mtllib paths are relative to dir
+  bool finish(const std::string& dir, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+              std::vector<tinyobj::material_t>& materials, std::string& warn, std::string& err);
+
+  // open, parse on the pool and finish; not from a task of the same pool
+  static bool load(const std::string& fileName, const std::string& dir, ThreadPool& pool, tinyobj::attrib_t& attrib,
+                   std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials, std::string& warn,
+                   std::string& err);
+};
+
+}  // namespace spt
+
+#endif
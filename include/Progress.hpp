@@ -0,0 +1,57 @@
+#ifndef SRE_PROGRESS_HPP
+#define SRE_PROGRESS_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+namespace spt {
+
+// render progress shared by all workers, they only bump relaxed counters in
+// batches while a single reporter thread prints the bar at a fixed rate
+class Progress {
+ private:
+  std::atomic<uint64_t> samples; // pixel samples finished
+  std::atomic<uint64_t> rays; // rays cast
+  uint64_t total; // expected pixel samples
+  float budget; // seconds, replaces total as the measure of progress if set
+  bool quiet;
+  std::chrono::steady_clock::time_point start;
+
+  std::thread reporter;
+  std::mutex mutex;
+  std::condition_variable wake;
+  bool stopping;
+
+  void run(float interval);
+  void print(bool final) const;
+
+ public:
+  // quiet starts no reporter, workers still count
+  Progress(uint64_t totalSamples, float timeBudget, bool quietMode, float interval = 0.25f);
+  ~Progress();
+
+  Progress(const Progress&) = delete;
+  Progress& operator=(const Progress&) = delete;
+
+  void add(uint64_t sampleCount, uint64_t rayCount) {
+    samples.fetch_add(sampleCount, std::memory_order_relaxed);
+    rays.fetch_add(rayCount, std::memory_order_relaxed);
+  }
+
+  // stop the reporter and print the final line
+  void finish();
+
+  // getter
+  uint64_t getSamples() const { return samples.load(std::memory_order_relaxed); }
+  uint64_t getRays() const { return rays.load(std::memory_order_relaxed); }
+  float getElapsed() const;
+  float getFraction() const;
+};
+
+}  // namespace spt
+
+#endif
@@ -9,15 +9,23 @@ class Ray {
   Vec3<float> origin;
   Vec3<float> direction;
 
+  // ray cone for texture filtering
+  float width = 0.f; // cone width at origin
+  float spread = 0.f; // cone spread angle
+
  public:
   Ray() = default;
   ~Ray() = default;
   Ray(const Vec3<float> &org, const Vec3<float> &dir) : origin(org), direction(normalize(dir)) {}
+  Ray(const Vec3<float> &org, const Vec3<float> &dir, float _width, float _spread)
+      : origin(org), direction(normalize(dir)), width(_width), spread(_spread) {}
 
   // getter
   Vec3<float> getOrigin() const { return origin; }
   Vec3<float> getDirection() const { return direction; }
   Vec3<float> getPointAt(const float &t) const { return origin + direction * t; }
+  float getSpread() const { return spread; }
+  float getWidthAt(const float &t) const { return width + spread * t; }
 };
 
 }  // namespace spt
@@ -0,0 +1,322 @@
+#ifndef SRE_SIMD_HPP
+#define SRE_SIMD_HPP
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+// internal to the spt library: only its own sources include this, all built with the
+// same flags, and public headers pass batches as plain Vec3 arrays. The types also sit
+// in a namespace named after the instruction set, so code built with other flags can
+// never end up sharing their inline bodies.
+#if defined(__AVX2__) && defined(__FMA__)
+#include <immintrin.h>
+#define SPT_AVX2 1
+#define SPT_SIMD_ISA avx2
+#elif defined(__SSE2__)
+// baseline on x86-64, so default builds are vectorised without any flags
+#include <emmintrin.h>
+#define SPT_SSE2 1
+#define SPT_SIMD_ISA sse2
+#else
+#define SPT_SIMD_ISA scalar
+#endif
+
+#include "Utils.hpp"
+
+namespace spt {
+inline namespace SPT_SIMD_ISA {
+
+// 8-lane float vector for SoA batches
+struct alignas(32) Float8 {
+#if defined(SPT_AVX2)
+  __m256 v;
+
+  Float8() : v(_mm256_setzero_ps()) {}
+  Float8(__m256 _v) : v(_v) {}
+  Float8(float s) : v(_mm256_set1_ps(s)) {}
+
+  static Float8 load(const float* p) { return _mm256_loadu_ps(p); }
+  void store(float* p) const { _mm256_storeu_ps(p, v); }
+
+  Float8 operator+(const Float8& o) const { return _mm256_add_ps(v, o.v); }
+  Float8 operator-(const Float8& o) const { return _mm256_sub_ps(v, o.v); }
+  Float8 operator*(const Float8& o) const { return _mm256_mul_ps(v, o.v); }
+  Float8 operator/(const Float8& o) const { return _mm256_div_ps(v, o.v); }
+  Float8 operator-() const { return _mm256_sub_ps(_mm256_setzero_ps(), v); }
+
+  // comparisons produce all-ones lanes
+  Float8 operator>(const Float8& o) const { return _mm256_cmp_ps(v, o.v, _CMP_GT_OQ); }
+  Float8 operator<(const Float8& o) const { return _mm256_cmp_ps(v, o.v, _CMP_LT_OQ); }
+  Float8 operator&(const Float8& o) const { return _mm256_and_ps(v, o.v); }
+
+  float operator[](int i) const {
+    alignas(32) float f[8];
+    _mm256_store_ps(f, v);
+    return f[i];
+  }
+#elif defined(SPT_SSE2)
+  // lanes 0-3 and 4-7
+  __m128 lo, hi;
+
+  Float8() : lo(_mm_setzero_ps()), hi(_mm_setzero_ps()) {}
+  Float8(__m128 _lo, __m128 _hi) : lo(_lo), hi(_hi) {}
+  Float8(float s) : lo(_mm_set1_ps(s)), hi(_mm_set1_ps(s)) {}
+
+  static Float8 load(const float* p) { return Float8(_mm_loadu_ps(p), _mm_loadu_ps(p + 4)); }
+  void store(float* p) const {
+    _mm_storeu_ps(p, lo);
+    _mm_storeu_ps(p + 4, hi);
+  }
+
+  // f applied to both halves
+  template <typename F>
+  static Float8 map(const Float8& a, const Float8& b, F f) { return Float8(f(a.lo, b.lo), f(a.hi, b.hi)); }
+
+  Float8 operator+(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_add_ps(a, b); }); }
+  Float8 operator-(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_sub_ps(a, b); }); }
+  Float8 operator*(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_mul_ps(a, b); }); }
+  Float8 operator/(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_div_ps(a, b); }); }
+  Float8 operator-() const { return Float8(0.f) - *this; }
+
+  // comparisons produce all-ones lanes
+  Float8 operator>(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_cmpgt_ps(a, b); }); }
+  Float8 operator<(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_cmplt_ps(a, b); }); }
+  Float8 operator&(const Float8& o) const { return map(*this, o, [](__m128 a, __m128 b) { return _mm_and_ps(a, b); }); }
+
+  float operator[](int i) const {
+    alignas(16) float f[8];
+    store(f);
+    return f[i];
+  }
+#else
+  float v[8];
+
+  Float8() : v{} {}
+  Float8(float s) { for (int i = 0; i < 8; i++) v[i] = s; }
+
+  static Float8 load(const float* p) { Float8 r; std::memcpy(r.v, p, sizeof(r.v)); return r; }
+  void store(float* p) const { std::memcpy(p, v, sizeof(v)); }
+
+  template <typename F>
+  static Float8 map(const Float8& a, const Float8& b, F f) { Float8 r; for (int i = 0; i < 8; i++) r.v[i] = f(a.v[i], b.v[i]); return r; }
+
+  Float8 operator+(const Float8& o) const { return map(*this, o, [](float a, float b) { return a + b; }); }
+  Float8 operator-(const Float8& o) const { return map(*this, o, [](float a, float b) { return a - b; }); }
+  Float8 operator*(const Float8& o) const { return map(*this, o, [](float a, float b) { return a * b; }); }
+  Float8 operator/(const Float8& o) const { return map(*this, o, [](float a, float b) { return a / b; }); }
+  Float8 operator-() const { return Float8(0.f) - *this; }
+
+  // comparisons produce all-ones lanes
+  static float mask(bool b) { uint32_t bits = b ? 0xFFFFFFFFu : 0u; float f; std::memcpy(&f, &bits, 4); return f; }
+  Float8 operator>(const Float8& o) const { return map(*this, o, [](float a, float b) { return mask(a > b); }); }
+  Float8 operator<(const Float8& o) const { return map(*this, o, [](float a, float b) { return mask(a < b); }); }
+  Float8 operator&(const Float8& o) const {
+    return map(*this, o, [](float a, float b) {
+      uint32_t x, y;
+      std::memcpy(&x, &a, 4);
+      std::memcpy(&y, &b, 4);
+      x &= y;
+      std::memcpy(&a, &x, 4);
+      return a;
+    });
+  }
+
+  float operator[](int i) const { return v[i]; }
+#endif
+};
+
+inline Float8 min(const Float8& a, const Float8& b) {
+#if defined(SPT_AVX2)
+  return _mm256_min_ps(a.v, b.v);
+#elif defined(SPT_SSE2)
+  return Float8::map(a, b, [](__m128 x, __m128 y) { return _mm_min_ps(x, y); });
+#else
+  return Float8::map(a, b, [](float x, float y) { return std::min(x, y); });
+#endif
+}
+
+inline Float8 max(const Float8& a, const Float8& b) {
+#if defined(SPT_AVX2)
+  return _mm256_max_ps(a.v, b.v);
+#elif defined(SPT_SSE2)
+  return Float8::map(a, b, [](__m128 x, __m128 y) { return _mm_max_ps(x, y); });
+#else
+  return Float8::map(a, b, [](float x, float y) { return std::max(x, y); });
+#endif
+}
+
+inline Float8 sqrt(const Float8& a) {
+#if defined(SPT_AVX2)
+  return _mm256_sqrt_ps(a.v);
+#elif defined(SPT_SSE2)
+  return Float8::map(a, a, [](__m128 x, __m128) { return _mm_sqrt_ps(x); });
+#else
+  return Float8::map(a, a, [](float x, float) { return ::sqrtf(x); });
+#endif
+}
+
+inline Float8 abs(const Float8& a) { return max(a, -a); }
+
+// a * b + c
+inline Float8 fmadd(const Float8& a, const Float8& b, const Float8& c) {
+#if defined(SPT_AVX2)
+  return _mm256_fmadd_ps(a.v, b.v, c.v);
+#else
+  return a * b + c;
+#endif
+}
+
+// mask ? a : b
+inline Float8 select(const Float8& mask, const Float8& a, const Float8& b) {
+#if defined(SPT_AVX2)
+  return _mm256_blendv_ps(b.v, a.v, mask.v);
+#elif defined(SPT_SSE2)
+  auto pick = [](__m128 m, __m128 x, __m128 y) { return _mm_or_ps(_mm_and_ps(m, x), _mm_andnot_ps(m, y)); };
+  return Float8(pick(mask.lo, a.lo, b.lo), pick(mask.hi, a.hi, b.hi));
+#else
+  Float8 r;
+  for (int i = 0; i < 8; i++) {
+    uint32_t bits;
+    std::memcpy(&bits, &mask.v[i], 4);
+    r.v[i] = bits ? a.v[i] : b.v[i];
+  }
+  return r;
+#endif
+}
+
+#if defined(SPT_AVX2) || defined(SPT_SSE2)
+// building blocks of exp2 and pow on the vector paths
+
+inline Float8 floor8(const Float8& x) {
+#if defined(SPT_AVX2)
+  return _mm256_floor_ps(x.v);
+#else
+  // truncate, then step down where that rounded up; sse2 has no floor
+  return Float8::map(x, x, [](__m128 a, __m128) {
+    __m128 t = _mm_cvtepi32_ps(_mm_cvttps_epi32(a));
+    return _mm_sub_ps(t, _mm_and_ps(_mm_cmpgt_ps(t, a), _mm_set1_ps(1.f)));
+  });
+#endif
+}
+
+// 2^n for whole n in [-126, 127], built in the exponent bits
+inline Float8 pow2i(const Float8& n) {
+#if defined(SPT_AVX2)
+  return _mm256_castsi256_ps(_mm256_slli_epi32(_mm256_add_epi32(_mm256_cvtps_epi32(n.v), _mm256_set1_epi32(127)), 23));
+#else
+  return Float8::map(n, n, [](__m128 a, __m128) {
+    return _mm_castsi128_ps(_mm_slli_epi32(_mm_add_epi32(_mm_cvtps_epi32(a), _mm_set1_epi32(127)), 23));
+  });
+#endif
+}
+
+// x = 2^e * m with m in [1, 2), for x > 0
+inline void frexp8(const Float8& x, Float8& e, Float8& m) {
+#if defined(SPT_AVX2)
+  __m256i bits = _mm256_castps_si256(x.v);
+  e = _mm256_cvtepi32_ps(_mm256_sub_epi32(_mm256_srli_epi32(bits, 23), _mm256_set1_epi32(127)));
+  m = _mm256_castsi256_ps(_mm256_or_si256(_mm256_and_si256(bits, _mm256_set1_epi32(0x007FFFFF)), _mm256_set1_epi32(0x3F800000)));
+#else
+  auto exponent = [](__m128 a, __m128) {
+    return _mm_cvtepi32_ps(_mm_sub_epi32(_mm_srli_epi32(_mm_castps_si128(a), 23), _mm_set1_epi32(127)));
+  };
+  auto mantissa = [](__m128 a, __m128) {
+    __m128i bits = _mm_castps_si128(a);
+    return _mm_castsi128_ps(_mm_or_si128(_mm_and_si128(bits, _mm_set1_epi32(0x007FFFFF)), _mm_set1_epi32(0x3F800000)));
+  };
+  e = Float8::map(x, x, exponent);
+  m = Float8::map(x, x, mantissa);
+#endif
+}
+#endif
+
+// 2^x, x clamped below to -126
+inline Float8 exp2(const Float8& x) {
+#if defined(SPT_AVX2) || defined(SPT_SSE2)
+  // 2^z = 2^floor(z) * 2^f, f in [0, 1)
+  Float8 z = min(max(x, -126.f), 127.f);
+  Float8 zi = floor8(z);
+  Float8 f = (z - zi) * 0.69314718f;
+  Float8 p = fmadd(fmadd(fmadd(fmadd(fmadd(fmadd(f, 1.f / 720, 1.f / 120), f, 1.f / 24), f, 1.f / 6), f, 0.5f), f, 1.f), f, 1.f);
+  return p * pow2i(zi);
+#else
+  return Float8::map(x, x, [](float a, float) { return ::exp2f(std::max(a, -126.f)); });
+#endif
+}
+
+inline Float8 exp(const Float8& x) { return exp2(x * 1.44269504f); }
+
+// x^y for x > 0, zero for x <= 0
+inline Float8 pow(const Float8& x, float y) {
+#if defined(SPT_AVX2) || defined(SPT_SSE2)
+  // log2(x) = e + log2(m), m in [1, 2), series in t = (m - 1) / (m + 1)
+  Float8 e, m;
+  frexp8(x, e, m);
+  Float8 t = (m - 1.f) / (m + 1.f);
+  Float8 t2 = t * t;
+  Float8 series = fmadd(fmadd(fmadd(t2, 1.f / 7, 1.f / 5), t2, 1.f / 3), t2, 1.f) * t;
+  Float8 log2x = fmadd(series, 2.f / 0.69314718f, e);
+
+  return select(x > 0.f, exp2(log2x * y), 0.f);
+#else
+  return Float8::map(x, x, [y](float a, float) { return a > 0.f ? ::powf(a, y) : 0.f; });
+#endif
+}
+
+// 8 Vec3 in SoA layout
+struct Vec3x8 {
+  Float8 x, y, z;
+
+  Vec3x8() = default;
+  Vec3x8(const Float8& a, const Float8& b, const Float8& c) : x(a), y(b), z(c) {}
+  Vec3x8(const Vec3<float>& a) : x(a.x), y(a.y), z(a.z) {}
+
+  // AoS <-> SoA
+  static Vec3x8 load(const Vec3<float> v[8]) {
+    alignas(32) float f[3][8];
+    for (int i = 0; i < 8; i++) {
+      f[0][i] = v[i].x;
+      f[1][i] = v[i].y;
+      f[2][i] = v[i].z;
+    }
+    return Vec3x8(Float8::load(f[0]), Float8::load(f[1]), Float8::load(f[2]));
+  }
+
+  void store(Vec3<float> v[8]) const {
+    alignas(32) float f[3][8];
+    x.store(f[0]);
+    y.store(f[1]);
+    z.store(f[2]);
+    for (int i = 0; i < 8; i++) {
+      v[i] = Vec3<float>(f[0][i], f[1][i], f[2][i]);
+    }
+  }
+
+  Vec3<float> get(int lane) const { return Vec3<float>(x[lane], y[lane], z[lane]); }
+
+  Vec3x8 operator+(const Vec3x8& o) const { return Vec3x8(x + o.x, y + o.y, z + o.z); }
+  Vec3x8 operator-(const Vec3x8& o) const { return Vec3x8(x - o.x, y - o.y, z - o.z); }
+  Vec3x8 operator*(const Vec3x8& o) const { return Vec3x8(x * o.x, y * o.y, z * o.z); }
+  Vec3x8 operator*(const Float8& k) const { return Vec3x8(x * k, y * k, z * k); }
+  Vec3x8 operator/(const Float8& k) const { return Vec3x8(x / k, y / k, z / k); }
+  Vec3x8 operator-() const { return Vec3x8(-x, -y, -z); }
+};
+
+inline Float8 dot(const Vec3x8& a, const Vec3x8& b) { return fmadd(a.x, b.x, fmadd(a.y, b.y, a.z * b.z)); }
+
+inline Vec3x8 normalize(const Vec3x8& a) { return a / sqrt(dot(a, a)); }
+
+inline Vec3x8 select(const Float8& mask, const Vec3x8& a, const Vec3x8& b) {
+  return Vec3x8(select(mask, a.x, b.x), select(mask, a.y, b.y), select(mask, a.z, b.z));
+}
+
+inline Vec3x8 pow(const Vec3x8& v, float k) { return Vec3x8(pow(v.x, k), pow(v.y, k), pow(v.z, k)); }
+
+// gamma correction of 8 linear colors
+inline Vec3x8 gammaCorrect(const Vec3x8& color, float gamma = 2.2f) { return pow(color, 1.f / gamma); }
+
+}  // namespace SPT_SIMD_ISA
+}  // namespace spt
+
+#endif
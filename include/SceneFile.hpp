@@ -0,0 +1,86 @@
+#ifndef SRE_SCENE_FILE_HPP
+#define SRE_SCENE_FILE_HPP
+
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+namespace spt {
+
+// one array of a compiled scene
+struct SceneSection {
+  uint64_t offset;
+  uint64_t count; // records, or bytes for string lists
+};
+
+// compiled scene header, followed by 64-byte aligned sections read in place
+struct SceneHeader {
+  char magic[4];
+  uint32_t version;
+  uint32_t materialSize, triangleSize, nodeSize; // record sizes of the build that wrote it
+  uint32_t reserved;
+  SceneSection config; // scene xml text
+  SceneSection dir; // scene directory relative to the file, textures and environment are found there
+  SceneSection materials, materialNames, textureNames;
+  SceneSection triangles; // in id order
+  SceneSection nodes, objectIds; // flattened bvh, root first, leaves refer to triangle ids
+  SceneSection lights; // ids of the emissive triangles in light order
+};
+
+// read-only mapping of a compiled scene, checked against corruption when opened
+class SceneFile {
+ private:
+  int fd;
+  const char* data;
+  size_t size;
+  SceneHeader header;
+
+  bool validate() const;
+
+ public:
+  SceneFile();
+  ~SceneFile();
+
+  SceneFile(const SceneFile&) = delete;
+  SceneFile& operator=(const SceneFile&) = delete;
+
+  bool open(const std::string& fileName);
+
+  // getter
+  const SceneHeader& getHeader() const { return header; }
+  size_t getFileSize() const { return size; }
+  template <typename T>
+  const T* get(const SceneSection& section) const {
+    return reinterpret_cast<const T*>(data + section.offset);
+  }
+  // string lists are nul separated
+  std::vector<std::string> getStrings(const SceneSection& section) const;
+};
+
+// writes the sections in the order they are added, the header on close
+class SceneWriter {
+ private:
+  std::string fileName, tmpName;
+  std::ofstream out;
+  SceneHeader header;
+
+  void align();
+
+ public:
+  bool open(const std::string& name);
+  SceneHeader& getHeader() { return header; }
+
+  template <typename T>
+  void add(SceneSection& section, const std::vector<T>& records) {
+    align();
+    section = {uint64_t(out.tellp()), records.size()};
+    out.write(reinterpret_cast<const char*>(records.data()), records.size() * sizeof(T));
+  }
+  void addStrings(SceneSection& section, const std::vector<std::string>& strings);
+  bool close();
+};
+
+}  // namespace spt
+
+#endif
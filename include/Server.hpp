@@ -0,0 +1,61 @@
+#ifndef SRE_SERVER_HPP
+#define SRE_SERVER_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+
+namespace spt {
+
+class ThreadPool;
+class Tracer;
+
+// long-lived render process, scenes stay loaded between jobs keyed by their files;
+// a job is one JSON object per line and is answered by one JSON object per line:
+//   {"scene": "dir/", "models": ["a.obj"], "config": "a.xml", "output": "a.png",
+//    "spp": 16, "depth": 5, "camera": {"eye": [x, y, z], "lookat": [...], "up": [...], "fovy": 40}}
+//   {"command": "unload", "scene": ..., "models": ..., "config": ...} drops a cached scene
+//   {"command": "quit"} stops the server
+class RenderServer {
+ private:
+  std::shared_ptr<ThreadPool> pool; // workers shared by all scenes
+  std::map<std::string, std::unique_ptr<Tracer>> scenes;
+  size_t depth, samples; // used by jobs that give none
+  float maxProb;
+
+  // one job at a time, each uses the whole pool
+  std::mutex jobMutex;
+
+  // socket mode
+  int listenFd;
+  std::mutex connectionMutex;
+  std::set<int> connections; // open client sockets
+  std::condition_variable drained; // a connection closed
+  std::atomic<bool> stopping;
+
+  // reply to a job line, false once a quit command arrived
+  bool handle(const std::string& line, std::string& reply);
+  void serveConnection(int fd);
+  void stop();
+
+ public:
+  // zero threads uses the hardware concurrency
+  RenderServer(size_t threads, size_t _depth, size_t _samples, float _p);
+  ~RenderServer();
+
+  RenderServer(const RenderServer&) = delete;
+  RenderServer& operator=(const RenderServer&) = delete;
+
+  // jobs from stdin, replies on stdout, render logs on stderr
+  void serveStdin();
+  // jobs from clients of a unix socket, one thread per connection
+  bool serveSocket(const std::string& path);
+};
+
+}  // namespace spt
+
+#endif
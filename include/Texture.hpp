@@ -1,28 +1,83 @@
 #ifndef SRE_TEXTURE_HPP
 #define SRE_TEXTURE_HPP
 
+#include <chrono>
+#include <functional>
+#include <memory>
+#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <vector>
 
 #include "Utils.hpp"
 
 namespace spt {
+
+class TaskGroup;
+class ThreadPool;
+
+enum TextureStorage {
+  TEXTURE_SRGB8, // 8-bit sRGB in native channel count, decoded through a lut
+  TEXTURE_LINEAR, // linear float rgb, no decode on lookup
+};
+
 class Texture {
  private:
-  int height, width, channels;
-  uint8_t* img;
+  // one level of the mip pyramid
+  struct MipLevel {
+    int width, height;
+    int tilesX, tilesY; // tiled storage
+    int64_t offset; // first tile in the tiled file
+    std::vector<uint8_t> texels; // TEXTURE_SRGB8, empty once paged out to tiles
+    std::vector<Vec3<float>> linear; // TEXTURE_LINEAR
+  };
+
+  static constexpr int TILE_SIZE = 64;
+  // textures up to this many texels are linearised to float at load
+  static constexpr int LINEAR_MAX_TEXELS = 1 << 20;
+
+  uint id;
+  int height = 0, width = 0, channels = 0;
+  TextureStorage storage = TEXTURE_SRGB8;
+  std::vector<MipLevel> levels; // levels[0] is the full resolution image
+  int fd = -1; // tiled file, texels come from the TextureCache if open
+  std::once_flag loaded;
+
   static std::unordered_map<std::string, Texture*> textures;
+  static std::mutex texturesMutex;
 
-  Texture() : img(nullptr) {}
-  Texture(const std::string& imgName);
+  Texture() = default;
   ~Texture();
 
+  void load(const std::string& texName);
+  void buildMipmaps();
+  bool writeTiled(const std::string& tiledName) const;
+  bool openTiled(const std::string& tiledName);
+  size_t tileBytes() const { return size_t(TILE_SIZE) * TILE_SIZE * channels; }
+  Vec3<float> decode(const uint8_t* t) const;
+  Vec3<float> texel(int level, int row, int col) const;
+  Vec3<float> bilinear(int level, const Vec2<float>& pos) const;
+
  public:
+  // thread-safe, concurrent requests of the same texture load it once
   static Texture* getInstance(const std::string& texName);
+  static size_t getCount();
+
+  // steady clock span of one texture decode
+  using DecodeTimer = std::function<void(std::chrono::steady_clock::time_point, std::chrono::steady_clock::time_point)>;
+  // queue a decode of every distinct non-empty name on pool under group, does not wait;
+  // onDecoded is called from the worker after each
+  static void preload(const std::vector<std::string>& texNames, ThreadPool& pool, const std::shared_ptr<TaskGroup>& group,
+                      const DecodeTimer& onDecoded = nullptr);
 
   // getter.
-  Vec3<float> getColorAt(const Vec2<float>& pos);
+  int getLevels() const { return levels.size(); }
+  int getChannels() const { return channels; }
+  TextureStorage getStorage() const { return storage; }
+  bool isTiled() const { return fd >= 0; }
+  // trilinear lookup of linear rgb, footprint is the filter width in uv units
+  Vec3<float> getColorAt(const Vec2<float>& pos, float footprint = 0.f);
 };
 }  // namespace spt
 
-#endif
\ No newline at end of file
+#endif
@@ -0,0 +1,64 @@
+#ifndef SRE_TEXTURE_CACHE_HPP
+#define SRE_TEXTURE_CACHE_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <list>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
+namespace spt {
+
+// fixed size texel block paged in from a tiled texture file
+using TextureTile = std::vector<uint8_t>;
+
+// fixed-budget LRU cache of texture tiles shared by all threads, tiles are
+// read on demand with pread and stay alive while a lookup still holds them
+class TextureCache {
+ public:
+  struct Stats {
+    uint64_t hits;
+    uint64_t misses;
+    uint64_t evictions;
+    size_t residentBytes;
+    double stallSeconds; // time spent waiting for tile reads
+  };
+
+ private:
+  struct Entry {
+    std::shared_ptr<const TextureTile> tile;
+    std::list<uint64_t>::iterator lru;
+  };
+
+  mutable std::mutex mutex;
+  std::list<uint64_t> lru; // most recently used first
+  std::unordered_map<uint64_t, Entry> tiles;
+  size_t budget;
+  size_t residentBytes;
+
+  std::atomic<uint64_t> hits, misses, evictions, stallNanos;
+
+  TextureCache() : budget(0), residentBytes(0), hits(0), misses(0), evictions(0), stallNanos(0) {}
+
+  void evict();
+
+ public:
+  static TextureCache& getInstance();
+
+  // budget in bytes, zero keeps textures fully in memory
+  void setBudget(size_t bytes);
+  size_t getBudget() const { return budget; }
+  bool isEnabled() const { return budget > 0; }
+
+  // tile identified by key, read from fd at offset when not resident
+  std::shared_ptr<const TextureTile> getTile(uint64_t key, int fd, int64_t offset, size_t bytes);
+
+  Stats getStats() const;
+  void resetStats();
+};
+
+}  // namespace spt
+
+#endif
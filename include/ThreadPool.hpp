@@ -0,0 +1,115 @@
+#ifndef SRE_THREAD_POOL_HPP
+#define SRE_THREAD_POOL_HPP
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace spt {
+
+// tasks of one job, queued tasks follow priority changes and the job waits
+// for its own tasks only, so jobs can share a pool
+class TaskGroup {
+ private:
+  friend class ThreadPool;
+
+  std::atomic<int> priority;
+  std::atomic<size_t> queued; // tasks in the deques
+  std::atomic<size_t> pending; // tasks queued or running
+  std::mutex mutex;
+  std::condition_variable idle;
+
+ public:
+  explicit TaskGroup(int _priority = 0) : priority(_priority), queued(0), pending(0) {}
+
+  TaskGroup(const TaskGroup&) = delete;
+  TaskGroup& operator=(const TaskGroup&) = delete;
+
+  // bumped by every priority change, pools then recompute their top priority
+  static inline std::atomic<unsigned> priorityChanges{0};
+
+  void setPriority(int p) {
+    priority = p;
+    priorityChanges++;
+  }
+  int getPriority() const { return priority; }
+};
+
+// work-stealing pool: each worker drains its own deques from the front and
+// steals from the back of the others once it runs dry; tasks of the highest
+// priority group with queued work are taken first
+class ThreadPool {
+ private:
+  struct Task {
+    std::function<void()> run;
+    std::shared_ptr<TaskGroup> group;
+  };
+
+  // tasks of one group on one worker
+  struct Queue {
+    std::shared_ptr<TaskGroup> group;
+    std::deque<std::function<void()>> tasks;
+  };
+
+  struct Worker {
+    std::mutex mutex;
+    std::vector<Queue> queues; // non-empty only, few as groups are few
+  };
+
+  std::vector<std::unique_ptr<Worker>> workers;
+  std::vector<std::thread> threads;
+
+  std::mutex mutex;
+  std::condition_variable wake; // tasks queued or stopping
+  std::condition_variable idle; // all tasks finished
+  std::atomic<size_t> queued; // tasks in the deques
+  std::atomic<size_t> pending; // tasks queued or running
+  std::atomic<size_t> next; // round robin target of submit
+  bool stopping;
+
+  // groups that may have queued tasks, plain submits go to the default group
+  std::mutex groupMutex;
+  std::vector<std::shared_ptr<TaskGroup>> groups;
+  std::shared_ptr<TaskGroup> defaultGroup;
+
+  // highest priority of the groups with queued tasks, read without a lock; recomputed
+  // under groupMutex once a group drains or any priority changes
+  std::atomic<int> top;
+  std::atomic<bool> topStale;
+  std::atomic<unsigned> seenChanges; // TaskGroup::priorityChanges top was computed at
+
+  void push(size_t worker, std::function<void()> task, const std::shared_ptr<TaskGroup>& group);
+  int topPriority();
+  bool take(Worker& worker, int priority, bool front, Task& task);
+  bool pop(size_t self, Task& task);
+  void loop(size_t self);
+
+ public:
+  // zero threads uses the hardware concurrency
+  explicit ThreadPool(size_t threadCount = 0);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool&) = delete;
+  ThreadPool& operator=(const ThreadPool&) = delete;
+
+  size_t size() const { return threads.size(); }
+
+  void submit(std::function<void()> task);
+  // consecutive tasks go to the same worker, so neighbouring work shares caches
+  void submit(std::vector<std::function<void()>> tasks);
+  void submit(std::vector<std::function<void()>> tasks, const std::shared_ptr<TaskGroup>& group);
+
+  // block until every submitted task has finished
+  void wait();
+  // block until the tasks of group have finished
+  void wait(TaskGroup& group);
+};
+
+}  // namespace spt
+
+#endif
@@ -0,0 +1,26 @@
+#ifndef SRE_TILE_HPP
+#define SRE_TILE_HPP
+
+#include <vector>
+
+namespace spt {
+
+enum TileOrder {
+  TILE_ORDER_SCANLINE, // row by row
+  TILE_ORDER_HILBERT, // hilbert curve, consecutive tiles are neighbours
+  TILE_ORDER_SPIRAL, // from the image center outwards
+};
+
+// image region [x0, x1) x [y0, y1), x is the column and y the row
+struct Tile {
+  int x0, y0, x1, y1;
+
+  int getArea() const { return (x1 - x0) * (y1 - y0); }
+};
+
+// split a width x height image into size x size tiles in the given order
+std::vector<Tile> makeTiles(int width, int height, int size, TileOrder order);
+
+}  // namespace spt
+
+#endif
@@ -1,7 +1,12 @@
 #ifndef SRE_TRACE_HPP
 #define SRE_TRACE_HPP
 
+#include <atomic>
+#include <climits>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <mutex>
 #include <string>
 #include <unordered_map>
 #include <vector>
@@ -9,33 +14,185 @@
 
 #include "BVH.hpp"
 #include "Light.hpp"
+#include "Material.hpp"
 #include "Camera.hpp"
+#include "Denoiser.hpp"
+#include "Film.hpp"
 #include "Ray.hpp"
+#include "Tile.hpp"
 
 namespace spt {
+
+class Progress;
+class ThreadPool;
+struct RenderState;
+struct ParsedModel;
+
+enum TraceMode {
+  TRACE_MIXED, // pick either light or bsdf sampling per vertex
+  TRACE_MIS, // light and bsdf sample per vertex, combined with power heuristic
+};
+
+enum RenderStatus {
+  RENDER_RUNNING,
+  RENDER_DONE,
+  RENDER_CANCELLED, // stopped early, a checkpoint keeps the samples so far, no image is written
+  RENDER_FAILED, // the image could not be written
+};
+
+// final pixels of a tile, row-major with the tile's width, tiles are in frame
+// coordinates; called on worker threads, concurrently for different tiles
+using TileCallback = std::function<void(const Tile& tile, const Vec3<float>* pixels)>;
+
+// an asynchronous render, copies refer to the same render
+class RenderHandle {
+ private:
+  std::shared_ptr<RenderState> state;
+  std::shared_future<RenderStatus> result;
+
+ public:
+  RenderHandle() = default;
+  RenderHandle(std::shared_ptr<RenderState> _state, std::shared_future<RenderStatus> _result)
+      : state(std::move(_state)), result(std::move(_result)) {}
+
+  bool isValid() const { return state != nullptr; }
+  // stops at the next tile row
+  void cancel();
+  // tiles of higher priority renders sharing a pool go first, queued tiles follow changes
+  void setPriority(int priority);
+  // finished fraction of the samples, or of the time budget
+  float getProgress() const;
+  RenderStatus getStatus() const;
+  RenderStatus wait() const { return result.get(); }
+  // false if still running after seconds
+  bool waitFor(float seconds) const;
+  const std::shared_future<RenderStatus>& getFuture() const { return result; }
+};
+
 class Tracer {
  private:
   std::shared_ptr<BVH> scene;
   Light light;
+  MaterialTable materials;
   Camera camera;
   size_t maxDepth;
   size_t samples;
   float maxProb;
+  TraceMode mode;
+  bool allLights; // TRACE_MIS: one shadow ray per light group instead of one in total
+  double textureLoadTime; // seconds spent decoding textures
+
+  // source of the loaded scene, kept for compiling it
+  std::string sceneDir;
+  std::string configXml;
+
+  // render scheduling
+  size_t threads; // zero uses the hardware concurrency
+  int tileSize;
+  TileOrder tileOrder;
+  std::shared_ptr<ThreadPool> pool;
+  bool sharedPool; // set by setPool, kept whatever the thread count
+
+  // progressive rendering
+  Film film;
+  int passSamples; // spp added per pass, zero renders all samples in one pass
+  std::string checkpoint; // resumed from and saved to if not empty
+  float checkpointInterval; // seconds between checkpoints
+
+  // adaptive sampling, pixels stop once their relative error is below the threshold
+  float adaptiveThreshold; // zero disables
+  int adaptiveMinSamples; // base spp before the error estimate is trusted
+
+  float timeBudget; // wall-clock seconds per render, zero renders a fixed spp
+
+  // distributed rendering, each process renders a window and a range of sample indices
+  Tile crop; // empty renders the whole frame
+  uint32_t sampleOffset; // index of the first sample, samples are rendered from here on
+  uint64_t seed; // base of the per-pixel random streams
+
+  // animation, the scene stays loaded while the camera follows the path
+  CameraPath cameraPath;
+  std::string frameOutput; // output name pattern, # runs become the zero-padded frame number
+
+  // denoising, guided by first-hit features gathered before the passes
+  int denoiseIterations; // zero disables
+  FeatureBuffer features;
+
+  // progress of the current render, printed by its own thread unless quiet
+  std::shared_ptr<Progress> progress;
+  bool quiet;
+  std::ostream* log; // load and render reports, std::cout unless set
+
+  // one render at a time, asynchronous ones queue behind it
+  std::mutex renderMutex;
+  std::vector<std::shared_future<RenderStatus>> asyncRenders;
 
  private:
-  bool loadConfig(const std::string &config, std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint& illuType);
-  bool loadModel(const std::string &model, const std::string &dir, const std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint illuType, std::vector<std::shared_ptr<Hittable>>& objects);
+  bool loadConfig(const std::string &xml, const std::string &dir, std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint& illuType);
+  void loadModel(const ParsedModel &model, const std::string &dir, const std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint illuType, uint firstId, std::vector<std::shared_ptr<Hittable>>& objects);
+  ThreadPool& workerPool();
   Vec3<float> trace(const Ray &ray, size_t depth);
+  Vec3<float> traceMIS(const Ray &ray);
+  RenderStatus run(const std::string& imgName, const TileCallback& onTile, RenderState& state);
+  // render the pixels of tile into out, a film that covers at least the tile
+  void renderTile(Film& out, const Tile& tile, uint32_t target, const std::atomic<bool>& cancelled);
+  void renderFeatures(const Tile& tile);
+  bool isConverged(const Film& source, int row, int col) const;
+
+  static float powerHeuristic(float pdfA, float pdfB);
 
   void print() const;
-  static void showProgress(float percent);
 
  public:
   Tracer(size_t _depth = 3, size_t _samples = 3, float _p = 0.5);
-  ~Tracer() = default;
+  ~Tracer();
+
+  // setter
+  void setThreads(size_t n) { threads = n; }
+  // workers owned elsewhere, e.g. shared by the scenes of a render server
+  void setPool(std::shared_ptr<ThreadPool> shared);
+  void setSamples(size_t spp) { samples = spp; }
+  void setDepth(size_t depth) { maxDepth = depth; }
+  void setTileSize(int size) { tileSize = size; }
+  void setTileOrder(TileOrder order) { tileOrder = order; }
+  void setPassSamples(int spp) { passSamples = spp; }
+  void setAdaptive(float threshold, int minSamples) {
+    adaptiveThreshold = threshold;
+    adaptiveMinSamples = minSamples;
+  }
+  void setTimeBudget(float seconds) { timeBudget = seconds; }
+  void setQuiet(bool q) { quiet = q; }
+  void setLog(std::ostream& out) { log = &out; }
+  void setDenoise(int iterations) { denoiseIterations = iterations; }
+  void setCrop(const Tile& window) { crop = window; }
+  void setSampleOffset(uint32_t offset) { sampleOffset = offset; }
+  void setSeed(uint64_t s) { seed = s; }
+  void setCheckpoint(const std::string& fileName, float interval) {
+    checkpoint = fileName;
+    checkpointInterval = interval;
+  }
+
+  // getter
+  size_t getSamples() const { return samples; }
+  size_t getDepth() const { return maxDepth; }
+  Camera& getCamera() { return camera; }
 
-  void load(const std::string &dir, const std::vector<std::string> &models, const std::string &config, int bvhMinCount);
-  void render(const std::string& imgName = "result.png");
+  bool load(const std::string &dir, const std::vector<std::string> &models, const std::string &config, int bvhMinCount = 30);
+  // binary scene written by sptc: triangles, bvh, materials and lights are read back without
+  // parsing or building, the config is embedded and textures are found relative to the file
+  bool loadCompiled(const std::string& fileName);
+  // write the loaded scene as a compiled one
+  bool saveCompiled(const std::string& fileName) const;
+  // camera keyframes from a sidecar file, after load
+  bool loadAnimation(const std::string& file);
+  bool hasAnimation() const { return !cameraPath.empty(); }
+  // false if the image could not be written
+  bool render(const std::string& imgName = "result.png");
+  // render on a thread of its own, an empty imgName only reports tiles to onTile;
+  // setters must wait until it finishes, the tracer's destructor waits for it
+  RenderHandle renderAsync(const std::string& imgName, TileCallback onTile = nullptr, int priority = 0);
+  // frames first to last of the camera path, all of them by default
+  void renderSequence(const std::string& pattern = "", int first = INT_MIN, int last = INT_MAX);
 };
 }  // namespace spt
 
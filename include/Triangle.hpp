@@ -6,24 +6,34 @@
 #include "Hittable.hpp"
 
 namespace spt {
-class Material;
+// plain copy of a triangle, as stored in compiled scene files
+struct TriangleRecord {
+  Vec3<float> v[3];
+  Vec2<float> vt[3];
+  Vec3<float> normal;
+  uint32_t mtlId;
+};
 
 class Triangle : public Hittable {
  private:
   Vec3<float> v1, v2, v3;
   Vec2<float> vt1, vt2, vt3;
   Vec3<float> normal;
-  Material material;
+  uint mtlId;
+  float uvScale; // sqrt(uv area / world area), maps cone width to uv units
+
+  bool intersect(const Ray& ray, float tMax, float& t, float& denom) const;
 
  public:
   Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2,
-           const Vec3<float>& _v3, const Material& _m);
+           const Vec3<float>& _v3, uint _mtlId);
   Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2,
-           const Vec3<float>& _v3, const Vec3<float>& _n, const Material& _m);
+           const Vec3<float>& _v3, const Vec3<float>& _n, uint _mtlId);
   Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2,
            const Vec3<float>& _v3, const Vec2<float>& _vt1,
            const Vec2<float>& _vt2, const Vec2<float>& _vt3,
-           const Vec3<float>& _n, const Material& _m);
+           const Vec3<float>& _n, uint _mtlId);
+  Triangle(size_t id, const TriangleRecord& record);
   ~Triangle();
 
  public:
@@ -32,14 +42,17 @@ class Triangle : public Hittable {
   virtual Vec3<float> getMaxXYZ() const override;
   Vec2<float> getTexCoord(const Vec3<float>& coord) const;
   Vec3<float> getRandomPoint() const;
-  Material getMaterial() const;
+  Vec3<float> getNormal() const;
+  uint getMaterialId() const;
   float getSize() const;
+  TriangleRecord getRecord() const;
 
   // contain
   bool contain(const Vec3<float>& p) const;
 
   // hit
   virtual void hit(const Ray& ray, HitResult& res) const override;
+  virtual bool occluded(const Ray& ray, float tMax) const override;
 };
 }  // namespace spt
 
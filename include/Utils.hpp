@@ -3,6 +3,7 @@
 
 #include <cassert>
 #include <cmath>
+#include <cstdint>
 #include <string>
 #include <vector>
 #include <ostream>
@@ -51,12 +52,7 @@ struct Vec3 {
 
   Vec3(const T arr[3]) : x(arr[0]), y(arr[1]), z(arr[2]) {}
 
-  Vec3& operator=(const Vec3<T>& other) {
-    x = other.x;
-    y = other.y;
-    z = other.z;
-    return *this;
-  }
+  Vec3& operator=(const Vec3<T>& other) = default;
 
   bool operator==(const Vec3<T>& other) const {
     return x == other.x && y == other.y && z == other.z;
@@ -187,15 +183,59 @@ static T distance(const Vec3<T>& v1, const Vec3<T>& v2) {
 
 template<typename T, typename K>
 static Vec3<T> pow(const Vec3<T>& v, const K& k) {
-  return Vec3<T>(::pow(v.x, k), ::pow(v.y, k), ::pow(v.z, k));
+  // stay in T, ::pow would promote floats to double
+  return Vec3<T>(std::pow(v.x, static_cast<T>(k)), std::pow(v.y, static_cast<T>(k)), std::pow(v.z, static_cast<T>(k)));
+}
+
+template<typename T>
+T luminance(const Vec3<T>& v) {
+  return v.x * 0.2126f + v.y * 0.7152f + v.z * 0.0722f;
+}
+
+// pcg32, small enough to reseed per pixel for reproducible sample streams
+class Pcg32 {
+ private:
+  uint64_t state, inc;
+
+ public:
+  using result_type = uint32_t;
+  static constexpr result_type min() { return 0; }
+  static constexpr result_type max() { return UINT32_MAX; }
+
+  explicit Pcg32(uint64_t s = 0x853c49e6748fea9bULL) { seed(s); }
+
+  void seed(uint64_t s, uint64_t stream = 0xda3e39cb94b95bdbULL) {
+    state = 0;
+    inc = (stream << 1u) | 1u;
+    (*this)();
+    state += s;
+    (*this)();
+  }
+
+  result_type operator()() {
+    uint64_t old = state;
+    state = old * 6364136223846793005ULL + inc;
+    uint32_t xorshifted = uint32_t(((old >> 18u) ^ old) >> 27u);
+    uint32_t rot = uint32_t(old >> 59u);
+    return (xorshifted >> rot) | (xorshifted << ((-rot) & 31));
+  }
+};
+
+// one generator per thread, render workers draw concurrently
+inline Pcg32& randEngine() {
+  thread_local Pcg32 gen((uint64_t(std::random_device{}()) << 32) | std::random_device{}());
+  return gen;
+}
+
+// restart the calling thread's random stream
+inline void seedRand(uint64_t seed) {
+  randEngine().seed(seed);
 }
 
 template<typename T>
 T rand(T max, T min = 0) {
   static_assert(std::is_arithmetic<T>::value, "T must be numeric type");
-
-  static std::random_device rd;
-  static std::mt19937 gen(rd());
+  Pcg32& gen = randEngine();
 
   if constexpr (std::is_integral<T>::value) {
     std::uniform_int_distribution<T> dis(min, max);
@@ -0,0 +1,53 @@
+# 在本机启动多个 worker 进程分布式渲染同一帧，再合并为最终图像
+# 用法: ./render-local.sh <worker 数> <输出文件> <spp> [main 的其他参数...]
+# 环境变量 SPLIT=crop 按行带切分画面，默认按采样区间切分
+if [ $# -lt 3 ]; then
+  echo "usage: $0 <workers> <output> <spp> [main options...]"
+  exit 1
+fi
+workers=$1
+output=$2
+spp=$3
+shift 3
+
+bin=${BIN:-./build}
+parts=$(mktemp -d)
+threads=$(( $(nproc) / workers ))
+[ "$threads" -lt 1 ] && threads=1
+
+# 按行带切分需要画面尺寸
+if [ "$SPLIT" = "crop" ]; then
+  width=${WIDTH:?SPLIT=crop needs WIDTH}
+  height=${HEIGHT:?SPLIT=crop needs HEIGHT}
+fi
+
+# 启动 worker
+echo "launching $workers workers, $threads threads each"
+pids=""
+for i in $(seq 0 $((workers - 1))); do
+  if [ "$SPLIT" = "crop" ]; then
+    y0=$(( height * i / workers ))
+    y1=$(( height * (i + 1) / workers ))
+    args="--crop 0,$y0,$width,$y1 --spp $spp"
+  else
+    s0=$(( spp * i / workers ))
+    s1=$(( spp * (i + 1) / workers ))
+    [ "$s0" -eq "$s1" ] && continue
+    args="--range $s0:$s1"
+  fi
+  "$bin/main" -q -t "$threads" $args -o "$parts/part$i.sptf" "$@" > "$parts/part$i.log" 2>&1 &
+  pids="$pids $!"
+done
+
+# 等待全部完成
+failed=0
+for pid in $pids; do
+  wait "$pid" || failed=1
+done
+if [ "$failed" -ne 0 ]; then
+  echo "a worker failed, logs in $parts"
+  exit 1
+fi
+
+# 合并
+"$bin/merge" "$output" "$parts"/part*.sptf && rm -rf "$parts"
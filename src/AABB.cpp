@@ -158,4 +158,35 @@ void AABB::hit(const Ray& ray, HitResult& res) const {
   res.hit = t0 <= t1;
   return;
 }
+
+bool AABB::hit(const Ray& ray, float tMax) const {
+  Vec3<float> origin = ray.getOrigin();
+  Vec3<float> direction = ray.getDirection();
+
+  float t0 = 0.f, t1 = tMax;
+  float o[3] = {origin.x, origin.y, origin.z};
+  float d[3] = {direction.x, direction.y, direction.z};
+  float lo[3] = {minXYZ.x, minXYZ.y, minXYZ.z};
+  float hi[3] = {maxXYZ.x, maxXYZ.y, maxXYZ.z};
+
+  for (int axis = 0; axis < 3; axis++) {
+    if (fabs(d[axis]) < EPSILON) {
+      if (o[axis] < lo[axis] || o[axis] > hi[axis]) {
+        return false;
+      }
+      continue;
+    }
+    float near = (lo[axis] - o[axis]) / d[axis];
+    float far = (hi[axis] - o[axis]) / d[axis];
+    if (near > far) {
+      std::swap(near, far);
+    }
+    t0 = std::max(t0, near);
+    t1 = std::min(t1, far);
+    if (t0 > t1) {
+      return false;
+    }
+  }
+  return true;
+}
 }  // namespace spt
@@ -69,6 +69,89 @@ std::shared_ptr<BVH> BVH::constructBVH(std::vector<std::shared_ptr<Hittable>>& o
   return bvh;
 }
 
+std::shared_ptr<BVH> BVH::combine(std::vector<std::shared_ptr<Hittable>>& meshes, int beg, int end) {
+  assert(end > beg);
+  if (end - beg == 1) {
+    return std::static_pointer_cast<BVH>(meshes[beg]);
+  }
+
+  auto bvh = std::make_shared<BVH>(0);
+  bvh->aabb = AABB(meshes.begin()+beg, meshes.begin()+end);
+  for (int i = beg; i < end; i++) {
+    bvh->n += static_cast<const BVH*>(meshes[i].get())->getSize();
+  }
+
+  // few meshes, every split is tried; sah weighted by their primitive counts
+  Vec3<float> deltaXYZ = bvh->getMaxXYZ()-bvh->getMinXYZ();
+  int axis = 0;
+  if (deltaXYZ.y > std::max(deltaXYZ.x, deltaXYZ.z)) {
+    axis = 1;
+  } else if(deltaXYZ.z > std::max(deltaXYZ.x, deltaXYZ.y)) {
+    axis = 2;
+  }
+  sortObjects(meshes, beg, end, axis);
+
+  int bestSplit = beg + 1;
+  float minCost = -1;
+  for (int split = beg+1; split < end; split++) {
+    int leftCount = 0, rightCount = 0;
+    for (int i = beg; i < end; i++) {
+      (i < split ? leftCount : rightCount) += static_cast<const BVH*>(meshes[i].get())->getSize();
+    }
+    AABB aabb1(meshes.begin()+beg, meshes.begin()+split);
+    AABB aabb2(meshes.begin()+split, meshes.begin()+end);
+    float cost = computeSAH(bvh->aabb, aabb1, aabb2, leftCount, rightCount);
+    if (minCost == -1 || cost < minCost) {
+      minCost = cost;
+      bestSplit = split;
+    }
+  }
+
+  bvh->objects.assign(2, nullptr);
+  bvh->objects[0] = combine(meshes, beg, bestSplit);
+  bvh->objects[1] = combine(meshes, bestSplit, end);
+  return bvh;
+}
+
+uint32_t BVH::flatten(std::vector<BVHNodeRecord>& nodes, std::vector<const Hittable*>& leafObjects) const {
+  uint32_t index = nodes.size();
+  nodes.push_back({aabb.getMinXYZ(), aabb.getMaxXYZ(), n, isLeaf, 0, 0});
+  if (isLeaf) {
+    nodes[index].begin = leafObjects.size();
+    for (const auto& object : objects) {
+      leafObjects.push_back(object.get());
+    }
+    nodes[index].end = leafObjects.size();
+    return index;
+  }
+
+  uint32_t left = static_cast<const BVH*>(objects[0].get())->flatten(nodes, leafObjects);
+  uint32_t right = static_cast<const BVH*>(objects[1].get())->flatten(nodes, leafObjects);
+  nodes[index].begin = left;
+  nodes[index].end = right;
+  return index;
+}
+
+std::shared_ptr<BVH> BVH::restore(const BVHNodeRecord* nodes, const uint32_t* objectIds,
+                                  const std::vector<std::shared_ptr<Hittable>>& objects, uint32_t index) {
+  const BVHNodeRecord& node = nodes[index];
+  auto bvh = std::make_shared<BVH>(node.n);
+  bvh->aabb = AABB(node.minXYZ, node.maxXYZ);
+  bvh->isLeaf = node.isLeaf != 0;
+  if (bvh->isLeaf) {
+    bvh->objects.reserve(node.end - node.begin);
+    for (uint32_t i = node.begin; i < node.end; i++) {
+      bvh->objects.push_back(objects[objectIds[i]]);
+    }
+    return bvh;
+  }
+
+  bvh->objects.assign(2, nullptr);
+  bvh->objects[0] = restore(nodes, objectIds, objects, node.begin);
+  bvh->objects[1] = restore(nodes, objectIds, objects, node.end);
+  return bvh;
+}
+
 // sort objects by axis
 void BVH::sortObjects(std::vector<std::shared_ptr<Hittable>>& objects, int beg, int end, int axis) {
   std::stable_sort(objects.begin()+beg, objects.begin()+end, [axis](std::shared_ptr<Hittable> obj1, std::shared_ptr<Hittable> obj2){
@@ -153,4 +236,60 @@ void BVH::hit(const Ray &ray, HitResult &res) const {
   }
   return ;
 }
+
+// occlusion, stop at the first hit
+bool BVH::occluded(const Ray &ray, float tMax) const {
+  if (!aabb.hit(ray, tMax)) {
+    return false;
+  }
+
+  for (const auto& obj : objects) {
+    if (obj->occluded(ray, tMax)) {
+      return true;
+    }
+  }
+  return false;
+}
+
+void BVH::occluded(ShadowBatch& batch) const {
+  batch.occluded.assign(batch.size(), 0);
+
+  // lanes of 64 rays as bit masks, so traversal allocates nothing
+  for (size_t base = 0; base < batch.size(); base += 64) {
+    size_t count = std::min<size_t>(64, batch.size() - base);
+    occluded(batch, base, count == 64 ? ~uint64_t(0) : (uint64_t(1) << count) - 1);
+  }
+}
+
+// traverse each node once for all rays still unresolved that overlap it, returns the lanes found occluded
+uint64_t BVH::occluded(ShadowBatch& batch, size_t base, uint64_t active) const {
+  uint64_t overlap = 0;
+  for (uint64_t m = active; m != 0; m &= m - 1) {
+    size_t i = base + __builtin_ctzll(m);
+    if (aabb.hit(batch.rays[i], batch.tMaxs[i])) {
+      overlap |= m & -m;
+    }
+  }
+  if (overlap == 0) {
+    return 0;
+  }
+
+  if (isLeaf) {
+    uint64_t hit = 0;
+    for (const auto& obj : objects) {
+      for (uint64_t m = overlap & ~hit; m != 0; m &= m - 1) {
+        size_t i = base + __builtin_ctzll(m);
+        if (obj->occluded(batch.rays[i], batch.tMaxs[i])) {
+          batch.occluded[i] = 1;
+          hit |= m & -m;
+        }
+      }
+    }
+    return hit;
+  }
+
+  assert(objects.size()==2); // left and right sub bvh
+  uint64_t hit = static_cast<const BVH*>(objects[0].get())->occluded(batch, base, overlap);
+  return hit | static_cast<const BVH*>(objects[1].get())->occluded(batch, base, overlap & ~hit);
+}
 }  // namespace spt
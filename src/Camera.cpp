@@ -1,5 +1,7 @@
 #include "Camera.hpp"
 
+#include <algorithm>
+
 namespace spt {
 
 Ray Camera::getRay(const int& row, const int& col) const {
@@ -10,13 +12,18 @@ Ray Camera::getRay(const int& row, const int& col) const {
   x *= (col + rand(0.999f)) / width;
 
   Vec3<float> pos = axisX * x + axisY * y + lowerLeftCorner;
-  return Ray(eye, pos - eye);
+
+  // cone through one pixel, spread = pixel height / focus
+  float spread = tanf(PI * fovy / 180 * 0.5f) * 2 / height;
+  return Ray(eye, pos - eye, 0.f, spread);
 }
 int Camera::getWidth() const { return width; }
 int Camera::getHeight() const { return height; }
 Vec3<float> Camera::getEye() const { return eye; }
 Vec3<float> Camera::getLookAt() const { return lookat; }
+Vec3<float> Camera::getUp() const { return up; }
 Vec3<float> Camera::getAxisZ() const { return axisZ; }
+float Camera::getFovy() const { return fovy; }
 
 // setter.
 void Camera::setWidth(const int& w) {
@@ -63,4 +70,46 @@ void Camera::update() {
   lowerLeftCorner = lookat - axisX * x - axisY * y;
 }
 
+void CameraPath::addKey(const CameraKey& key) {
+  auto itr = std::lower_bound(keys.begin(), keys.end(), key.frame,
+                              [](const CameraKey& k, int frame) { return k.frame < frame; });
+  if (itr != keys.end() && itr->frame == key.frame) {
+    *itr = key;
+  } else {
+    keys.insert(itr, key);
+  }
+}
+
+// uniform catmull-rom segment from p1 to p2
+static Vec3<float> catmullRom(const Vec3<float>& p0, const Vec3<float>& p1, const Vec3<float>& p2, const Vec3<float>& p3, float t) {
+  float t2 = t * t, t3 = t2 * t;
+  return (p1 * 2.f + (p2 - p0) * t + (p0 * 2.f - p1 * 5.f + p2 * 4.f - p3) * t2 + (p1 * 3.f - p0 - p2 * 3.f + p3) * t3) * 0.5f;
+}
+
+void CameraPath::apply(Camera& camera, float frame) const {
+  if (keys.empty()) {
+    return;
+  }
+
+  // segment [i, i + 1] containing frame, end keys repeat at the ends
+  size_t i = 0;
+  while (i + 2 < keys.size() && keys[i + 1].frame <= frame) {
+    i++;
+  }
+  const CameraKey& k1 = keys[i];
+  const CameraKey& k2 = keys[std::min(i + 1, keys.size() - 1)];
+  const CameraKey& k0 = keys[i > 0 ? i - 1 : 0];
+  const CameraKey& k3 = keys[std::min(i + 2, keys.size() - 1)];
+  float span = float(k2.frame - k1.frame);
+  float t = span > 0.f ? std::clamp((frame - k1.frame) / span, 0.f, 1.f) : 0.f;
+
+  Vec3<float> eye = catmullRom(k0.eye, k1.eye, k2.eye, k3.eye, t);
+  Vec3<float> lookat = catmullRom(k0.lookat, k1.lookat, k2.lookat, k3.lookat, t);
+  Vec3<float> up = normalize(k1.up * (1.f - t) + k2.up * t);
+  camera.setFovy(k1.fovy * (1.f - t) + k2.fovy * t);
+  camera.setUp(up.x, up.y, up.z);
+  camera.setLookAt(lookat.x, lookat.y, lookat.z);
+  camera.setEye(eye.x, eye.y, eye.z);
+}
+
 }  // namespace spt
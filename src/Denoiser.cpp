@@ -0,0 +1,185 @@
+#include "Denoiser.hpp"
+#include "SIMD.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+
+namespace spt {
+
+// B3 spline, separable
+static const float KERNEL[5] = {1.f / 16, 1.f / 4, 3.f / 8, 1.f / 4, 1.f / 16};
+
+// filtered quantities as separate planes, so 8 neighbouring pixels load as one vector,
+// probe is a noise image of the input's variance filtered with the same weights
+struct Planes {
+  std::vector<float> r, g, b, probe;
+
+  explicit Planes(size_t n) : r(n), g(n), b(n), probe(n) {}
+};
+
+// constant over the iterations, invLum is the luminance edge stop from the input noise
+struct Guides {
+  std::vector<float> nx, ny, nz, z, invLum;
+
+  explicit Guides(size_t n) : nx(n), ny(n), nz(n), z(n), invLum(n) {}
+};
+
+struct Pass {
+  const Planes& in;
+  Planes& out;
+  const Guides& guides;
+  int width, height, step;
+  float sigmaNormal, sigmaDepth;
+};
+
+// the same filter code runs on one pixel (float) and on 8 pixels of a row (Float8)
+template <typename T> T load(const float* p);
+template <> inline float load<float>(const float* p) { return *p; }
+template <> inline Float8 load<Float8>(const float* p) { return Float8::load(p); }
+inline void store(float* p, float v) { *p = v; }
+inline void store(float* p, const Float8& v) { v.store(p); }
+inline float expT(float x) { return ::expf(x); }
+inline Float8 expT(const Float8& x) { return exp(x); }
+inline float powT(float x, float y) { return x > 0.f ? ::powf(x, y) : 0.f; }
+inline Float8 powT(const Float8& x, float y) { return pow(x, y); }
+inline float absT(float x) { return ::fabsf(x); }
+inline Float8 absT(const Float8& x) { return abs(x); }
+
+// pixel at (row, x), inBounds false skips taps past the left or right edge
+template <typename T>
+static void filterPixel(const Pass& p, int row, int x, bool inBounds) {
+  const Planes& in = p.in;
+  const Guides& g = p.guides;
+  int i = row * p.width + x;
+
+  T r = load<T>(&in.r[i]), gr = load<T>(&in.g[i]), b = load<T>(&in.b[i]);
+  T nx = load<T>(&g.nx[i]), ny = load<T>(&g.ny[i]), nz = load<T>(&g.nz[i]), z = load<T>(&g.z[i]);
+  T lum = r * 0.2126f + gr * 0.7152f + b * 0.0722f;
+
+  // edge stopping scales, luminance against the pixel's own noise, depth relative to distance
+  T invLum = load<T>(&g.invLum[i]);
+  T invDepth = T(1.f) / (z * (p.sigmaDepth * p.step) + 1e-4f);
+
+  // the center tap always counts, also for pixels without a surface
+  float c = KERNEL[2] * KERNEL[2];
+  T sumW = T(c), sumR = r * c, sumG = gr * c, sumB = b * c, sumProbe = load<T>(&in.probe[i]) * c;
+
+  for (int dy = -2; dy <= 2; dy++) {
+    int qy = row + dy * p.step;
+    if (qy < 0 || qy >= p.height) {
+      continue;
+    }
+    for (int dx = -2; dx <= 2; dx++) {
+      int qx = x + dx * p.step;
+      if ((dx == 0 && dy == 0) || (!inBounds && (qx < 0 || qx >= p.width))) {
+        continue;
+      }
+      int j = qy * p.width + qx;
+
+      T qr = load<T>(&in.r[j]), qg = load<T>(&in.g[j]), qb = load<T>(&in.b[j]);
+      T qlum = qr * 0.2126f + qg * 0.7152f + qb * 0.0722f;
+      T cosN = nx * load<T>(&g.nx[j]) + ny * load<T>(&g.ny[j]) + nz * load<T>(&g.nz[j]);
+      T dz = absT(z - load<T>(&g.z[j]));
+
+      T w = expT(-(absT(lum - qlum) * invLum + dz * invDepth)) * powT(cosN, p.sigmaNormal) * (KERNEL[dx + 2] * KERNEL[dy + 2]);
+      sumW = sumW + w;
+      sumR = sumR + qr * w;
+      sumG = sumG + qg * w;
+      sumB = sumB + qb * w;
+      sumProbe = sumProbe + load<T>(&in.probe[j]) * w;
+    }
+  }
+
+  T invW = T(1.f) / sumW;
+  store(&p.out.r[i], sumR * invW);
+  store(&p.out.g[i], sumG * invW);
+  store(&p.out.b[i], sumB * invW);
+  store(&p.out.probe[i], sumProbe * invW);
+}
+
+// vector body where all taps of 8 pixels are inside the row, scalar edges
+static void filterRow(const Pass& p, int row) {
+  int radius = 2 * p.step;
+  int x = 0;
+  for (; x < std::min(radius, p.width); x++) {
+    filterPixel<float>(p, row, x, false);
+  }
+  for (; x + 8 <= p.width - radius; x += 8) {
+    filterPixel<Float8>(p, row, x, true);
+  }
+  for (; x < p.width; x++) {
+    filterPixel<float>(p, row, x, false);
+  }
+}
+
+float Denoiser::denoise(std::vector<Vec3<float>>& colors, const std::vector<float>& variances, const FeatureBuffer& features,
+                        ThreadPool& pool) const {
+  int w = features.width, h = features.height;
+  size_t n = size_t(w) * h;
+  if (n == 0 || colors.size() != n || variances.size() != n) {
+    return 1.f;
+  }
+
+  // demodulate albedo, the filter then only smooths lighting
+  Planes a(n), b(n);
+  Guides guides(n);
+  std::vector<float> scales(n);
+  double varianceBefore = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    const Vec3<float>& albedo = features.albedo[i];
+    Vec3<float> inv(1.f / std::max(albedo.x, 0.01f), 1.f / std::max(albedo.y, 0.01f), 1.f / std::max(albedo.z, 0.01f));
+    scales[i] = std::max(luminance(albedo), 0.01f);
+    a.r[i] = colors[i].x * inv.x;
+    a.g[i] = colors[i].y * inv.y;
+    a.b[i] = colors[i].z * inv.z;
+    float sigma = ::sqrtf(std::max(variances[i], 0.f)) / scales[i];
+    varianceBefore += variances[i];
+
+    // random sign from a hash of the index, same deviation as the pixel
+    uint32_t hash = uint32_t(i) * 0x9E3779B1u;
+    hash ^= hash >> 15;
+    a.probe[i] = ((hash * 0x85EBCA77u) >> 31) ? sigma : -sigma;
+    guides.invLum[i] = 1.f / (sigma * sigmaLuminance + 1e-4f);
+
+    guides.nx[i] = features.normal[i].x;
+    guides.ny[i] = features.normal[i].y;
+    guides.nz[i] = features.normal[i].z;
+    guides.z[i] = features.depth[i];
+  }
+
+  // one task per band of rows, iterations ping-pong between the planes;
+  // waits for its own tasks only, the pool may be shared with other renders
+  const int band = 8;
+  auto group = std::make_shared<TaskGroup>();
+  Planes* in = &a;
+  Planes* out = &b;
+  for (int iter = 0; iter < iterations; iter++) {
+    Pass pass{*in, *out, guides, w, h, 1 << iter, sigmaNormal, sigmaDepth};
+    std::vector<std::function<void()>> tasks;
+    for (int y0 = 0; y0 < h; y0 += band) {
+      tasks.push_back([&pass, y0, h, band] {
+        for (int row = y0; row < std::min(y0 + band, h); row++) {
+          filterRow(pass, row);
+        }
+      });
+    }
+    pool.submit(std::move(tasks), group);
+    pool.wait(*group);
+    std::swap(in, out);
+  }
+
+  // remodulate
+  double varianceAfter = 0.0;
+  for (size_t i = 0; i < n; i++) {
+    const Vec3<float>& albedo = features.albedo[i];
+    colors[i] = Vec3<float>(in->r[i] * std::max(albedo.x, 0.01f), in->g[i] * std::max(albedo.y, 0.01f),
+                            in->b[i] * std::max(albedo.z, 0.01f));
+    varianceAfter += in->probe[i] * in->probe[i] * scales[i] * scales[i];
+  }
+
+  return varianceAfter > 0.0 ? float(varianceBefore / varianceAfter) : 1.f;
+}
+
+}  // namespace spt
@@ -0,0 +1,140 @@
+#include "Distribution.hpp"
+
+#include <algorithm>
+#include <cassert>
+
+namespace spt {
+
+AliasTable::AliasTable(const std::vector<float>& weights) : total(0.f) {
+  size_t n = weights.size();
+  for (float w : weights) {
+    assert(w >= 0.f);
+    total += w;
+  }
+  if (n == 0 || total <= 0.f) {
+    return;
+  }
+
+  probs.resize(n);
+  cutoffs.resize(n);
+  aliases.resize(n);
+
+  // scaled probabilities, average is exactly 1
+  std::vector<float> scaled(n);
+  std::vector<uint> small, large;
+  for (uint i = 0; i < n; i++) {
+    probs[i] = weights[i] / total;
+    scaled[i] = probs[i] * n;
+    if (scaled[i] < 1.f) {
+      small.push_back(i);
+    } else {
+      large.push_back(i);
+    }
+  }
+
+  // pair each under-full bucket with an over-full one
+  while (!small.empty() && !large.empty()) {
+    uint s = small.back(), l = large.back();
+    small.pop_back();
+
+    cutoffs[s] = scaled[s];
+    aliases[s] = l;
+
+    scaled[l] = (scaled[l] + scaled[s]) - 1.f;
+    if (scaled[l] < 1.f) {
+      large.pop_back();
+      small.push_back(l);
+    }
+  }
+
+  // remaining buckets are full (up to rounding error)
+  for (uint i : large) {
+    cutoffs[i] = 1.f;
+    aliases[i] = i;
+  }
+  for (uint i : small) {
+    cutoffs[i] = 1.f;
+    aliases[i] = i;
+  }
+}
+
+Distribution1D::Distribution1D(const float* f, int n) : func(f, f + n), cdf(n + 1) {
+  // integrate
+  cdf[0] = 0.f;
+  for (int i = 1; i <= n; i++) {
+    cdf[i] = cdf[i - 1] + func[i - 1] / n;
+  }
+  integral = cdf[n];
+
+  // normalize, fall back to uniform for an all-zero function
+  for (int i = 1; i <= n; i++) {
+    cdf[i] = integral > 0.f ? cdf[i] / integral : 1.f * i / n;
+  }
+}
+
+float Distribution1D::sample(float u, float* pdf, int* offset) const {
+  // last cdf entry not greater than u
+  int idx = std::upper_bound(cdf.begin(), cdf.end(), u) - cdf.begin() - 1;
+  idx = std::clamp(idx, 0, static_cast<int>(func.size()) - 1);
+
+  float du = u - cdf[idx];
+  if (cdf[idx + 1] - cdf[idx] > 0.f) {
+    du /= cdf[idx + 1] - cdf[idx];
+  }
+
+  if (pdf != nullptr) {
+    *pdf = integral > 0.f ? func[idx] / integral : 0.f;
+  }
+  if (offset != nullptr) {
+    *offset = idx;
+  }
+  return (idx + du) / size();
+}
+
+Distribution2D::Distribution2D(const float* f, int nu, int nv) {
+  for (int v = 0; v < nv; v++) {
+    conditionals.emplace_back(f + v * nu, nu);
+  }
+
+  std::vector<float> marginalFunc;
+  for (int v = 0; v < nv; v++) {
+    marginalFunc.push_back(conditionals[v].getIntegral());
+  }
+  marginal = Distribution1D(marginalFunc.data(), nv);
+}
+
+Vec2<float> Distribution2D::sample(float u0, float u1, float* pdf) const {
+  float pdfs[2];
+  int v;
+  float d1 = marginal.sample(u1, &pdfs[1], &v);
+  float d0 = conditionals[v].sample(u0, &pdfs[0]);
+  *pdf = pdfs[0] * pdfs[1];
+  return Vec2<float>(d0, d1);
+}
+
+float Distribution2D::pdf(const Vec2<float>& p) const {
+  int nu = conditionals[0].size(), nv = marginal.size();
+  int iu = std::clamp(static_cast<int>(p.u * nu), 0, nu - 1);
+  int iv = std::clamp(static_cast<int>(p.v * nv), 0, nv - 1);
+  if (marginal.getIntegral() <= 0.f) {
+    return 0.f;
+  }
+  return conditionals[iv].getFunc(iu) / marginal.getIntegral();
+}
+
+uint AliasTable::sample(float u1, float u2, float* prob) const {
+  assert(!empty());
+
+  uint n = probs.size();
+  uint idx = std::min(static_cast<uint>(u1 * n), n - 1);
+  if (u2 >= cutoffs[idx]) {
+    idx = aliases[idx];
+  }
+
+  if (prob != nullptr) {
+    *prob = probs[idx];
+  }
+  return idx;
+}
+
+}  // namespace spt
@@ -0,0 +1,96 @@
+#include "Environment.hpp"
+
+#include <algorithm>
+#include <iostream>
+#include <stb_image.h>
+
+namespace spt {
+
+Environment::Environment(const std::string& imgName, float _scale) : width(0), height(0), scale(_scale) {
+  // float rgb, stb converts ldr images to linear
+  int channels;
+  float* img = stbi_loadf(imgName.c_str(), &width, &height, &channels, 3);
+  if (img == nullptr) {
+    std::cerr << "Error: Environment load failure (file: " << imgName << ")" << std::endl;
+    width = height = 0;
+    return;
+  }
+
+  pixels.resize(width * height);
+  for (int i = 0; i < width * height; i++) {
+    pixels[i] = Vec3<float>(img[i * 3 + 0], img[i * 3 + 1], img[i * 3 + 2]) * scale;
+  }
+  stbi_image_free(img);
+
+  // sampling weights, sin(theta) compensates for the stretching at the poles
+  std::vector<float> func(width * height);
+  for (int row = 0; row < height; row++) {
+    float sinTheta = sinf(PI * (row + 0.5f) / height);
+    for (int col = 0; col < width; col++) {
+      func[row * width + col] = luminance(pixels[row * width + col]) * sinTheta;
+    }
+  }
+  distribution = Distribution2D(func.data(), width, height);
+}
+
+Vec2<float> Environment::toUV(const Vec3<float>& dir) {
+  float theta = acosf(std::clamp(dir.y, -1.f, 1.f));
+  float phi = atan2f(dir.z, dir.x);
+  if (phi < 0) {
+    phi += 2 * PI;
+  }
+  return Vec2<float>(phi / (2 * PI), theta / PI);
+}
+
+Vec3<float> Environment::toDirection(const Vec2<float>& uv) {
+  float theta = uv.v * PI, phi = uv.u * 2 * PI;
+  float sinTheta = sinf(theta);
+  return Vec3<float>(sinTheta * cosf(phi), cosf(theta), sinTheta * sinf(phi));
+}
+
+Vec3<float> Environment::lookup(const Vec2<float>& uv) const {
+  int col = std::clamp(static_cast<int>(uv.u * width), 0, width - 1);
+  int row = std::clamp(static_cast<int>(uv.v * height), 0, height - 1);
+  return pixels[row * width + col];
+}
+
+Vec3<float> Environment::getRadiance(const Vec3<float>& dir) const {
+  if (!isValid()) {
+    return Vec3<float>(0.f, 0.f, 0.f);
+  }
+  return lookup(toUV(dir));
+}
+
+Vec3<float> Environment::sample(Vec3<float>& dir, float& pdf) const {
+  pdf = 0.f;
+  if (!isValid() || distribution.empty()) {
+    return Vec3<float>(0.f, 0.f, 0.f);
+  }
+
+  float pdfUV;
+  Vec2<float> uv = distribution.sample(rand(1.f), rand(1.f), &pdfUV);
+  float sinTheta = sinf(uv.v * PI);
+  if (pdfUV <= 0.f || sinTheta <= 0.f) {
+    return Vec3<float>(0.f, 0.f, 0.f);
+  }
+
+  // jacobian of the (u, v) -> (theta, phi) -> direction mapping
+  dir = toDirection(uv);
+  pdf = pdfUV / (2 * PI * PI * sinTheta);
+  return lookup(uv);
+}
+
+float Environment::pdf(const Vec3<float>& dir) const {
+  if (!isValid() || distribution.empty()) {
+    return 0.f;
+  }
+
+  Vec2<float> uv = toUV(dir);
+  float sinTheta = sinf(uv.v * PI);
+  if (sinTheta <= 0.f) {
+    return 0.f;
+  }
+  return distribution.pdf(uv) / (2 * PI * PI * sinTheta);
+}
+
+}  // namespace spt
@@ -0,0 +1,248 @@
+#include "Film.hpp"
+#include "SIMD.hpp"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+
+namespace spt {
+
+// checkpoint header, followed by the sums, luminance sums, squared luminance sums and counts arrays
+struct FilmHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t width, height;
+  int32_t originX, originY;
+  int32_t frameWidth, frameHeight;
+};
+
+static const char FILM_MAGIC[4] = {'S', 'P', 'T', 'F'};
+static const uint32_t FILM_VERSION = 4; // 4: double luminance sums
+
+Film::Film(int w, int h) : Film(w, h, 0, 0, w, h) {}
+
+Film::Film(int w, int h, int x, int y, int frameW, int frameH)
+    : width(w), height(h), originX(x), originY(y), frameWidth(frameW), frameHeight(frameH),
+      sums(w * h, Vec3<float>(0, 0, 0)), lumSums(w * h, 0.0), lumSqSums(w * h, 0.0), counts(w * h, 0) {}
+
+uint32_t Film::getMinCount() const {
+  return counts.empty() ? 0 : *std::min_element(counts.begin(), counts.end());
+}
+
+uint64_t Film::getTotalCount() const {
+  uint64_t total = 0;
+  for (uint32_t n : counts) {
+    total += n;
+  }
+  return total;
+}
+
+Vec3<float> Film::getPixel(int row, int col) const {
+  int idx = index(row, col);
+  return counts[idx] ? sums[idx] / counts[idx] : Vec3<float>(0, 0, 0);
+}
+
+float Film::getVariance(int row, int col) const {
+  int idx = index(row, col);
+  uint32_t n = counts[idx];
+  double mean = n ? lumSums[idx] / n : 0.0;
+  if (n < 2) {
+    return mean * mean;
+  }
+
+  // unbiased sample variance, then variance of the mean
+  double variance = std::max(0.0, (lumSqSums[idx] - lumSums[idx] * mean) / (n - 1));
+  return variance / n;
+}
+
+float Film::getError(int row, int col) const {
+  int idx = index(row, col);
+  uint32_t n = counts[idx];
+  if (n < 2) {
+    return FLT_MAX;
+  }
+
+  // dark pixels are judged against a floor, not against ~0
+  float mean = lumSums[idx] / n;
+  return ::sqrtf(getVariance(row, col)) / std::max(mean, 0.01f);
+}
+
+std::vector<Vec3<float>> Film::getImage() const {
+  std::vector<Vec3<float>> colors(width * height);
+  for (int i = 0; i < width * height; i++) {
+    colors[i] = counts[i] ? sums[i] / counts[i] : Vec3<float>(0, 0, 0);
+  }
+  return colors;
+}
+
+void Film::clear() {
+  std::fill(sums.begin(), sums.end(), Vec3<float>(0, 0, 0));
+  std::fill(lumSums.begin(), lumSums.end(), 0.0);
+  std::fill(lumSqSums.begin(), lumSqSums.end(), 0.0);
+  std::fill(counts.begin(), counts.end(), 0);
+}
+
+Film Film::crop(int x, int y, int w, int h) const {
+  // relative to this window
+  x = std::clamp(x - originX, 0, width);
+  y = std::clamp(y - originY, 0, height);
+  w = std::clamp(w, 0, width - x);
+  h = std::clamp(h, 0, height - y);
+
+  Film part(w, h, originX + x, originY + y, frameWidth, frameHeight);
+  for (int row = 0; row < h; row++) {
+    int src = (y + row) * width + x, dst = row * w;
+    std::copy_n(&sums[src], w, &part.sums[dst]);
+    std::copy_n(&lumSums[src], w, &part.lumSums[dst]);
+    std::copy_n(&lumSqSums[src], w, &part.lumSqSums[dst]);
+    std::copy_n(&counts[src], w, &part.counts[dst]);
+  }
+  return part;
+}
+
+bool Film::merge(const Film& part) {
+  int x = part.originX - originX, y = part.originY - originY;
+  if (part.frameWidth != frameWidth || part.frameHeight != frameHeight || x < 0 || y < 0 ||
+      x + part.width > width || y + part.height > height) {
+    return false;
+  }
+
+  // disjoint sample streams simply add up
+  for (int row = 0; row < part.height; row++) {
+    for (int col = 0; col < part.width; col++) {
+      int src = row * part.width + col, dst = (y + row) * width + x + col;
+      sums[dst] += part.sums[src];
+      lumSums[dst] += part.lumSums[src];
+      lumSqSums[dst] += part.lumSqSums[src];
+      counts[dst] += part.counts[src];
+    }
+  }
+  return true;
+}
+
+std::vector<uint8_t> Film::toImage(std::vector<Vec3<float>> colors) {
+  size_t count = colors.size();
+  colors.resize(count + 8, Vec3<float>(0, 0, 0));
+
+  // gamma correction, 8 pixels at a time
+  for (size_t i = 0; i < count; i += 8) {
+    Vec3x8 color = gammaCorrect(Vec3x8::load(&colors[i])) * 255.f;
+    color.store(&colors[i]);
+  }
+
+  std::vector<uint8_t> img(count * 3);
+  for (size_t i = 0; i < count; i++) {
+    img[i * 3 + 0] = std::min(255.f, colors[i].x);
+    img[i * 3 + 1] = std::min(255.f, colors[i].y);
+    img[i * 3 + 2] = std::min(255.f, colors[i].z);
+  }
+  return img;
+}
+
+bool Film::save(const std::string& fileName) const {
+  std::string tmpName = fileName + ".tmp";
+  {
+    std::ofstream out(tmpName, std::ios::binary | std::ios::trunc);
+    if (!out) {
+      return false;
+    }
+
+    FilmHeader header;
+    std::memcpy(header.magic, FILM_MAGIC, 4);
+    header.version = FILM_VERSION;
+    header.width = width;
+    header.height = height;
+    header.originX = originX;
+    header.originY = originY;
+    header.frameWidth = frameWidth;
+    header.frameHeight = frameHeight;
+    out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+    out.write(reinterpret_cast<const char*>(sums.data()), sums.size() * sizeof(Vec3<float>));
+    out.write(reinterpret_cast<const char*>(lumSums.data()), lumSums.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(lumSqSums.data()), lumSqSums.size() * sizeof(double));
+    out.write(reinterpret_cast<const char*>(counts.data()), counts.size() * sizeof(uint32_t));
+    if (!out.good()) {
+      return false;
+    }
+  }
+
+  // an interrupted save never leaves a truncated checkpoint behind
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+// read a film file, sizes are checked against expected unless it is null
+static bool readFilm(const std::string& fileName, FilmHeader& header, const FilmHeader* expected,
+                     std::vector<Vec3<float>>& s, std::vector<double>& l, std::vector<double>& lSq,
+                     std::vector<uint32_t>& c) {
+  std::ifstream in(fileName, std::ios::binary);
+  if (!in) {
+    return false;
+  }
+
+  in.read(reinterpret_cast<char*>(&header), sizeof(header));
+  if (!in.good() || std::memcmp(header.magic, FILM_MAGIC, 4) != 0 || header.version != FILM_VERSION ||
+      header.width < 0 || header.height < 0) {
+    return false;
+  }
+  if (expected != nullptr &&
+      (header.width != expected->width || header.height != expected->height || header.originX != expected->originX ||
+       header.originY != expected->originY || header.frameWidth != expected->frameWidth ||
+       header.frameHeight != expected->frameHeight)) {
+    return false;
+  }
+
+  size_t n = size_t(header.width) * header.height;
+  s.resize(n);
+  l.resize(n);
+  lSq.resize(n);
+  c.resize(n);
+  in.read(reinterpret_cast<char*>(s.data()), s.size() * sizeof(Vec3<float>));
+  in.read(reinterpret_cast<char*>(l.data()), l.size() * sizeof(double));
+  in.read(reinterpret_cast<char*>(lSq.data()), lSq.size() * sizeof(double));
+  in.read(reinterpret_cast<char*>(c.data()), c.size() * sizeof(uint32_t));
+  return in.good();
+}
+
+bool Film::load(const std::string& fileName) {
+  FilmHeader expected = {{}, FILM_VERSION, width, height, originX, originY, frameWidth, frameHeight};
+  FilmHeader header;
+  std::vector<Vec3<float>> s;
+  std::vector<double> l, lSq;
+  std::vector<uint32_t> c;
+  if (!readFilm(fileName, header, &expected, s, l, lSq, c)) {
+    return false;
+  }
+
+  sums.swap(s);
+  lumSums.swap(l);
+  lumSqSums.swap(lSq);
+  counts.swap(c);
+  return true;
+}
+
+bool Film::loadPartial(const std::string& fileName) {
+  FilmHeader header;
+  std::vector<Vec3<float>> s;
+  std::vector<double> l, lSq;
+  std::vector<uint32_t> c;
+  if (!readFilm(fileName, header, nullptr, s, l, lSq, c)) {
+    return false;
+  }
+
+  width = header.width;
+  height = header.height;
+  originX = header.originX;
+  originY = header.originY;
+  frameWidth = header.frameWidth;
+  frameHeight = header.frameHeight;
+  sums.swap(s);
+  lumSums.swap(l);
+  lumSqSums.swap(lSq);
+  counts.swap(c);
+  return true;
+}
+
+}  // namespace spt
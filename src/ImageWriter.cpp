@@ -0,0 +1,196 @@
+#include "ImageWriter.hpp"
+
+#include <cstring>
+#include <fcntl.h>
+#include <strings.h>
+#include <unistd.h>
+#include <vector>
+
+namespace spt {
+
+// little-endian hosts only, both formats store little-endian values
+template<typename T>
+static void append(std::vector<char>& buf, const T& value) {
+  const char* p = reinterpret_cast<const char*>(&value);
+  buf.insert(buf.end(), p, p + sizeof(T));
+}
+
+static void appendString(std::vector<char>& buf, const std::string& s) {
+  buf.insert(buf.end(), s.begin(), s.end());
+  buf.push_back('\0');
+}
+
+static void appendAttribute(std::vector<char>& buf, const std::string& name, const std::string& type, int32_t size) {
+  appendString(buf, name);
+  appendString(buf, type);
+  append(buf, size);
+}
+
+// single part scanline header, channels in the alphabetical order the format requires
+static std::vector<char> exrHeader(int w, int h) {
+  std::vector<char> buf;
+  append(buf, int32_t(20000630)); // magic
+  append(buf, int32_t(2)); // version 2, scanline
+
+  appendAttribute(buf, "channels", "chlist", 3 * 18 + 1);
+  for (const char* name : {"B", "G", "R"}) {
+    appendString(buf, name);
+    append(buf, int32_t(2)); // FLOAT
+    append(buf, int32_t(0)); // pLinear and reserved
+    append(buf, int32_t(1)); // x sampling
+    append(buf, int32_t(1)); // y sampling
+  }
+  buf.push_back('\0');
+
+  appendAttribute(buf, "compression", "compression", 1);
+  buf.push_back(0); // NO_COMPRESSION
+
+  for (const char* window : {"dataWindow", "displayWindow"}) {
+    appendAttribute(buf, window, "box2i", 16);
+    append(buf, int32_t(0));
+    append(buf, int32_t(0));
+    append(buf, int32_t(w - 1));
+    append(buf, int32_t(h - 1));
+  }
+
+  appendAttribute(buf, "lineOrder", "lineOrder", 1);
+  buf.push_back(0); // INCREASING_Y
+
+  appendAttribute(buf, "pixelAspectRatio", "float", 4);
+  append(buf, 1.f);
+
+  appendAttribute(buf, "screenWindowCenter", "v2f", 8);
+  append(buf, 0.f);
+  append(buf, 0.f);
+
+  appendAttribute(buf, "screenWindowWidth", "float", 4);
+  append(buf, 1.f);
+
+  buf.push_back('\0'); // end of header
+  return buf;
+}
+
+ImageWriter::~ImageWriter() {
+  close();
+}
+
+ImageFormat ImageWriter::getFormat(const std::string& fileName) {
+  auto endsWith = [&fileName](const char* ext) {
+    size_t n = strlen(ext);
+    return fileName.size() >= n && strcasecmp(fileName.c_str() + fileName.size() - n, ext) == 0;
+  };
+  if (endsWith(".pfm")) {
+    return IMAGE_PFM;
+  }
+  if (endsWith(".exr")) {
+    return IMAGE_EXR;
+  }
+  if (endsWith(".sptf")) {
+    return IMAGE_FILM;
+  }
+  return IMAGE_PNG;
+}
+
+bool ImageWriter::writeAt(const void* data, size_t bytes, int64_t offset) const {
+  const char* p = static_cast<const char*>(data);
+  while (bytes > 0) {
+    ssize_t n = ::pwrite(fd, p, bytes, offset);
+    if (n <= 0) {
+      return false;
+    }
+    p += n;
+    bytes -= n;
+    offset += n;
+  }
+  return true;
+}
+
+bool ImageWriter::open(const std::string& fileName, int w, int h, ImageFormat f) {
+  close();
+  if ((f != IMAGE_PFM && f != IMAGE_EXR) || w <= 0 || h <= 0) {
+    return false;
+  }
+
+  fd = ::open(fileName.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) {
+    return false;
+  }
+  width = w;
+  height = h;
+  format = f;
+
+  int64_t rowBytes = int64_t(w) * 3 * sizeof(float);
+  std::vector<char> header;
+  int64_t fileSize = 0;
+  if (format == IMAGE_PFM) {
+    // negative scale marks little-endian
+    std::string text = "PF\n" + std::to_string(w) + ' ' + std::to_string(h) + "\n-1.0\n";
+    header.assign(text.begin(), text.end());
+    dataOffset = header.size();
+    fileSize = dataOffset + rowBytes * h;
+  } else {
+    // header, offset table, then per scanline its y, byte count and planar B, G, R
+    header = exrHeader(w, h);
+    dataOffset = header.size() + int64_t(h) * sizeof(uint64_t);
+    for (int y = 0; y < h; y++) {
+      append(header, uint64_t(dataOffset + y * (8 + rowBytes)));
+    }
+    fileSize = dataOffset + (8 + rowBytes) * h;
+  }
+
+  // sparse until written, unwritten pixels read back as zero
+  bool ok = writeAt(header.data(), header.size(), 0) && ::ftruncate(fd, fileSize) == 0;
+  if (ok && format == IMAGE_EXR) {
+    for (int y = 0; y < h && ok; y++) {
+      int32_t prefix[2] = {y, int32_t(rowBytes)};
+      ok = writeAt(prefix, sizeof(prefix), dataOffset + y * (8 + rowBytes));
+    }
+  }
+  if (!ok) {
+    close();
+  }
+  return ok;
+}
+
+bool ImageWriter::writeRow(int row, int col, const Vec3<float>* pixels, int count) const {
+  if (fd < 0 || row < 0 || row >= height || col < 0 || col + count > width) {
+    return false;
+  }
+
+  if (format == IMAGE_PFM) {
+    int64_t offset = dataOffset + ((int64_t(height - 1 - row) * width) + col) * 3 * sizeof(float);
+    std::vector<float> rgb(count * 3);
+    for (int i = 0; i < count; i++) {
+      rgb[i * 3] = pixels[i].x;
+      rgb[i * 3 + 1] = pixels[i].y;
+      rgb[i * 3 + 2] = pixels[i].z;
+    }
+    return writeAt(rgb.data(), rgb.size() * sizeof(float), offset);
+  }
+
+  // planar channels, one write per channel span
+  int64_t line = dataOffset + row * (8 + int64_t(width) * 3 * sizeof(float)) + 8;
+  std::vector<float> channel(count);
+  for (int c = 0; c < 3; c++) {
+    for (int i = 0; i < count; i++) {
+      const Vec3<float>& p = pixels[i];
+      channel[i] = (c == 0) ? p.z : (c == 1) ? p.y : p.x;
+    }
+    int64_t offset = line + (int64_t(c) * width + col) * sizeof(float);
+    if (!writeAt(channel.data(), count * sizeof(float), offset)) {
+      return false;
+    }
+  }
+  return true;
+}
+
+bool ImageWriter::close() {
+  if (fd < 0) {
+    return true;
+  }
+  bool ok = ::close(fd) == 0;
+  fd = -1;
+  return ok;
+}
+
+}  // namespace spt
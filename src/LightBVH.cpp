@@ -0,0 +1,298 @@
+#include "LightBVH.hpp"
+
+#include <algorithm>
+#include <cassert>
+#include <cstdlib>
+
+namespace spt {
+
+namespace {
+float safeSqrt(float x) { return ::sqrtf(std::max(0.f, x)); }
+
+// cos(max(0, a - b)) from cosines and sines of a and b
+float cosSubClamped(float sinA, float cosA, float sinB, float cosB) {
+  if (cosA > cosB) {
+    return 1.f;
+  }
+  return cosA * cosB + sinA * sinB;
+}
+
+// sin(max(0, a - b)) from cosines and sines of a and b
+float sinSubClamped(float sinA, float cosA, float sinB, float cosB) {
+  if (cosA > cosB) {
+    return 0.f;
+  }
+  return sinA * cosB - cosA * sinB;
+}
+
+Vec3<float> getCenter(const AABB& aabb) { return (aabb.getMinXYZ() + aabb.getMaxXYZ()) * 0.5f; }
+
+// any vector perpendicular to v
+Vec3<float> perpendicular(const Vec3<float>& v) {
+  Vec3<float> a = fabs(v.x) > 0.9f ? Vec3<float>(0, 1, 0) : Vec3<float>(1, 0, 0);
+  return normalize(cross(v, a));
+}
+
+// rotate v towards u's orthogonal component by angle theta
+Vec3<float> rotateTowards(const Vec3<float>& v, const Vec3<float>& u, float theta) {
+  Vec3<float> wp = u - v * dot(v, u);
+  if (wp.length() < EPSILON) {
+    wp = perpendicular(v);
+  }
+  wp.normalize();
+  return normalize(v * cosf(theta) + wp * sinf(theta));
+}
+
+// orientation cone measure used by the split heuristic
+float coneMeasure(float cosThetaO, float cosThetaE) {
+  float thetaO = acosf(std::clamp(cosThetaO, -1.f, 1.f));
+  float thetaE = acosf(std::clamp(cosThetaE, -1.f, 1.f));
+  float thetaW = std::min(thetaO + thetaE, PI);
+  float sinThetaO = safeSqrt(1 - cosThetaO * cosThetaO);
+  return 2 * PI * (1 - cosThetaO) +
+         PI / 2 * (2 * thetaW * sinThetaO - cosf(thetaO - 2 * thetaW) - 2 * thetaO * sinThetaO + cosThetaO);
+}
+}  // namespace
+
+float LightBounds::importance(const Vec3<float>& p, const Vec3<float>& n) const {
+  if (phi <= 0.f) {
+    return 0.f;
+  }
+
+  // squared distance to center, clamped to avoid blowing up inside the bounds
+  Vec3<float> pc = getCenter(aabb);
+  Vec3<float> diag = aabb.getMaxXYZ() - aabb.getMinXYZ();
+  float d2 = dot(p - pc, p - pc);
+  d2 = std::max(d2, diag.length() / 2);
+
+  // angle between cone axis and direction to p, emitters are two-sided so the cone holds
+  // the normals up to their sign
+  Vec3<float> wi = normalize(p - pc);
+  float cosThetaW = fabs(dot(w, wi));
+  float sinThetaW = safeSqrt(1 - cosThetaW * cosThetaW);
+
+  // angle subtended by the bounds as seen from p
+  float radius2 = dot(diag, diag) / 4;
+  float cosThetaB = -1.f;
+  if (dot(p - pc, p - pc) > radius2) {
+    float sin2ThetaB = radius2 / dot(p - pc, p - pc);
+    cosThetaB = safeSqrt(1 - sin2ThetaB);
+  }
+  float sinThetaB = safeSqrt(1 - cosThetaB * cosThetaB);
+
+  // minimum angle between the emission cone and p
+  float sinThetaO = safeSqrt(1 - cosThetaO * cosThetaO);
+  float cosThetaX = cosSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  float sinThetaX = sinSubClamped(sinThetaW, cosThetaW, sinThetaO, cosThetaO);
+  float cosThetaP = cosSubClamped(sinThetaX, cosThetaX, sinThetaB, cosThetaB);
+  if (cosThetaP <= cosThetaE) {
+    return 0.f;
+  }
+
+  float imp = phi * cosThetaP / d2;
+
+  // incident cosine bound at the receiver
+  if (n != Vec3<float>(0.f, 0.f, 0.f)) {
+    float cosThetaI = fabs(dot(wi, n));
+    float sinThetaI = safeSqrt(1 - cosThetaI * cosThetaI);
+    imp *= cosSubClamped(sinThetaI, cosThetaI, sinThetaB, cosThetaB);
+  }
+
+  return std::max(imp, 0.f);
+}
+
+LightBounds LightBounds::merge(const LightBounds& a, const LightBounds& b) {
+  if (a.phi <= 0.f) return b;
+  if (b.phi <= 0.f) return a;
+
+  // union of the two direction cones, b's axis flipped towards a's since only the sign differs
+  Vec3<float> w;
+  float cosThetaO;
+  Vec3<float> bw = dot(a.w, b.w) < 0.f ? -b.w : b.w;
+  float thetaA = acosf(std::clamp(a.cosThetaO, -1.f, 1.f));
+  float thetaB = acosf(std::clamp(b.cosThetaO, -1.f, 1.f));
+  float thetaD = acosf(std::clamp(dot(a.w, bw), -1.f, 1.f));
+
+  if (std::min(thetaD + thetaB, PI) <= thetaA) {
+    w = a.w;
+    cosThetaO = a.cosThetaO;
+  } else if (std::min(thetaD + thetaA, PI) <= thetaB) {
+    w = bw;
+    cosThetaO = b.cosThetaO;
+  } else {
+    float thetaO = (thetaA + thetaD + thetaB) / 2;
+    if (thetaO >= PI) {
+      w = a.w;
+      cosThetaO = -1.f;
+    } else {
+      w = rotateTowards(a.w, bw, thetaO - thetaA);
+      cosThetaO = cosf(thetaO);
+    }
+  }
+
+  return LightBounds(AABB::merge(a.aabb, b.aabb), a.phi + b.phi, w, cosThetaO, std::min(a.cosThetaE, b.cosThetaE));
+}
+
+void LightBVH::build(const std::vector<std::shared_ptr<Triangle>>& lights, const std::vector<float>& powers) {
+  assert(lights.size() == powers.size());
+  nodes.clear();
+  trails.assign(lights.size(), 0);
+
+  std::vector<std::pair<uint, LightBounds>> items;
+  for (uint i = 0; i < lights.size(); i++) {
+    if (powers[i] <= 0.f) {
+      continue;
+    }
+    AABB aabb(lights[i]->getMinXYZ(), lights[i]->getMaxXYZ());
+    // area light: all normals equal, emits over the hemisphere on either side
+    items.emplace_back(i, LightBounds(aabb, powers[i], lights[i]->getNormal(), 1.f, 0.f));
+  }
+
+  if (!items.empty()) {
+    build(items, 0, items.size(), 0, 0);
+  }
+}
+
+uint LightBVH::build(std::vector<std::pair<uint, LightBounds>>& items, int beg, int end, uint64_t trail, int depth) {
+  assert(beg < end);
+  assert(depth < 64); // a trail bit per level, see MAX_SAH_DEPTH
+
+  uint nidx = nodes.size();
+  nodes.emplace_back();
+
+  // leaf node
+  if (end - beg == 1) {
+    nodes[nidx].bounds = items[beg].second;
+    nodes[nidx].index = items[beg].first;
+    nodes[nidx].isLeaf = true;
+    trails[items[beg].first] = trail;
+    return nidx;
+  }
+
+  // centroid bounds
+  Vec3<float> cmin = getCenter(items[beg].second.aabb), cmax = cmin;
+  LightBounds bounds;
+  for (int i = beg; i < end; i++) {
+    Vec3<float> c = getCenter(items[i].second.aabb);
+    cmin = Vec3<float>(std::min(cmin.x, c.x), std::min(cmin.y, c.y), std::min(cmin.z, c.z));
+    cmax = Vec3<float>(std::max(cmax.x, c.x), std::max(cmax.y, c.y), std::max(cmax.z, c.z));
+    bounds = LightBounds::merge(bounds, items[i].second);
+  }
+
+  // split on the longest centroid axis with a power/area/orientation weighted cost
+  Vec3<float> delta = cmax - cmin;
+  int axis = 0;
+  if (delta.y > std::max(delta.x, delta.z)) {
+    axis = 1;
+  } else if (delta.z > std::max(delta.x, delta.y)) {
+    axis = 2;
+  }
+  auto coord = [axis](const Vec3<float>& v) { return axis == 0 ? v.x : (axis == 1 ? v.y : v.z); };
+
+  std::sort(items.begin() + beg, items.begin() + end, [&](const auto& a, const auto& b) {
+    return coord(getCenter(a.second.aabb)) < coord(getCenter(b.second.aabb));
+  });
+
+  auto cost = [](const LightBounds& b) {
+    return b.phi * b.aabb.getArea() * coneMeasure(b.cosThetaO, b.cosThetaE);
+  };
+
+  // median split for coincident centroids and deep levels, ties go to the split nearest the median;
+  // otherwise equal costs peel off one light per level and trails run out of bits
+  int count = end - beg;
+  int median = beg + count / 2;
+  int bestSplit = median;
+  if (coord(delta) > 0.f && depth < MAX_SAH_DEPTH) {
+    // sweep prefix and suffix bounds
+    std::vector<LightBounds> suffix(count + 1);
+    for (int i = count - 1; i >= 0; i--) {
+      suffix[i] = LightBounds::merge(suffix[i + 1], items[beg + i].second);
+    }
+
+    float minCost = -1;
+    LightBounds prefix;
+    int step = std::max(1, count / 16);
+    for (int i = 0; i < count - 1; i++) {
+      prefix = LightBounds::merge(prefix, items[beg + i].second);
+      if ((i + 1) % step != 0) {
+        continue;
+      }
+      float c = cost(prefix) + cost(suffix[i + 1]);
+      int split = beg + i + 1;
+      if (minCost < 0 || c < minCost || (c == minCost && std::abs(split - median) < std::abs(bestSplit - median))) {
+        minCost = c;
+        bestSplit = split;
+      }
+    }
+  }
+
+  build(items, beg, bestSplit, trail, depth + 1);
+  uint second = build(items, bestSplit, end, trail | (uint64_t(1) << depth), depth + 1);
+
+  nodes[nidx].bounds = bounds;
+  nodes[nidx].index = second;
+  nodes[nidx].isLeaf = false;
+  return nidx;
+}
+
+bool LightBVH::sample(const Vec3<float>& p, const Vec3<float>& n, float u, uint& lidx, float& prob) const {
+  if (nodes.empty()) {
+    return false;
+  }
+
+  uint nidx = 0;
+  prob = 1.f;
+  while (true) {
+    const LightBVHNode& node = nodes[nidx];
+    if (node.isLeaf) {
+      if (nidx == 0 && node.bounds.importance(p, n) <= 0.f) {
+        return false;
+      }
+      lidx = node.index;
+      return true;
+    }
+
+    // choose child proportional to its importance, reuse u
+    float ci[2] = {nodes[nidx + 1].bounds.importance(p, n), nodes[node.index].bounds.importance(p, n)};
+    if (ci[0] == 0.f && ci[1] == 0.f) {
+      return false;
+    }
+    float p0 = ci[0] / (ci[0] + ci[1]);
+    if (u < p0) {
+      nidx = nidx + 1;
+      u = std::min(u / p0, 0.99999994f);
+      prob *= p0;
+    } else {
+      nidx = node.index;
+      u = std::min((u - p0) / (1 - p0), 0.99999994f);
+      prob *= 1 - p0;
+    }
+  }
+}
+
+float LightBVH::pmf(const Vec3<float>& p, const Vec3<float>& n, uint lidx) const {
+  if (nodes.empty() || lidx >= trails.size()) {
+    return 0.f;
+  }
+
+  uint64_t trail = trails[lidx];
+  uint nidx = 0;
+  float prob = 1.f;
+  while (true) {
+    const LightBVHNode& node = nodes[nidx];
+    if (node.isLeaf) {
+      return node.index == lidx ? prob : 0.f;
+    }
+
+    float ci[2] = {nodes[nidx + 1].bounds.importance(p, n), nodes[node.index].bounds.importance(p, n)};
+    if (ci[0] == 0.f && ci[1] == 0.f) {
+      return 0.f;
+    }
+    int child = trail & 1;
+    prob *= ci[child] / (ci[0] + ci[1]);
+    nidx = child == 0 ? nidx + 1 : node.index;
+    trail >>= 1;
+  }
+}
+
+}  // namespace spt
@@ -1,4 +1,5 @@
 #include "Material.hpp"
+#include "SIMD.hpp"
 
 #include <cassert>
 #include <iostream>
@@ -13,12 +14,31 @@ namespace spt
 
     uint Material::illuMask = 0b1100000;
 
-    Material::Material(const tinyobj::material_t& mtl, const std::string& dir, uint illuType) {
-        // name
-        name = mtl.name;
+    // opaque rough white dielectric, usable without a loaded material
+    Material::Material() {
+        albedo = nullptr;
+        diffuse = Vec3(1.f, 1.f, 1.f);
+        metallic = 0.f;
+        roughness = 1.f;
+        alpha2 = 1.f;
+        k = 0.5f;
+        f0 = 0.04f;
+        ior = 1.f;
+        f0Eta = 0.f;
+        transparency = 0.f;
+        specular = Vec3(0.f, 0.f, 0.f);
+        shininess = 0.f;
+        emission = Vec3(0.f, 0.f, 0.f);
+        emissive = false;
+
+        type = BSDF_MICROFACET | BSDF_REFLECTION | BSDF_DIFFUSE;
+        kernel = resolveKernel(type);
+    }
 
+    Material::Material(const tinyobj::material_t& mtl, const std::string& dir, uint illuType) {
         // emissive
         emissive = false;
+        emission = Vec3(0.f, 0.f, 0.f);
 
         // diffuse
         diffuse = mtl.diffuse;
@@ -44,6 +64,13 @@ namespace spt
         // ior
         ior = mtl.ior;
 
+        // derived constants
+        float alpha = roughness * roughness;
+        alpha2 = alpha * alpha;
+        k = (roughness + 1.0f) * (roughness + 1.0f) / 8.0f;
+        f0 = 0.04f * (1 - metallic);
+        f0Eta = (ior - 1) * (ior - 1) / ((ior + 1) * (ior + 1));
+
         // Kd Texture
         if (!mtl.diffuse_texname.empty()) {
             auto texName = dir+mtl.diffuse_texname;
@@ -68,23 +95,38 @@ namespace spt
         } else {
             type = type | BSDF_GLOSSY;
         }
+
+        // specialised kernels for this type
+        kernel = resolveKernel(type);
     }
 
     bool Material::isEmissive() const { 
         return emissive;
     }
 
+    bool Material::isSpecular() const {
+        return (type & surfMask) == BSDF_SPECULAR;
+    }
+
     void Material::setEmission(Vec3<float> e) { 
         emissive = true;
         emission = e;
     }
 
-    uint Material::getType() const {
-        return type;
+    Material Material::unlinked() const {
+        Material mtl = *this;
+        mtl.kernel = nullptr;
+        mtl.albedo = nullptr;
+        return mtl;
+    }
+
+    void Material::link(Texture* texture) {
+        albedo = texture;
+        kernel = resolveKernel(type);
     }
 
-    std::string Material::getName() const {
-        return name;
+    uint Material::getType() const {
+        return type;
     }
 
     Vec3<float> Material::getEmission() const {
@@ -95,11 +137,60 @@ namespace spt
         }
     }
 
-    Vec3<float> Material::getBaseColor(Vec2<float> uv) const {
+    Vec3<float> Material::getBaseColor(Vec2<float> uv, float footprint) const {
         if (albedo == nullptr) {
             return diffuse;
         } else {
-            return albedo->getColorAt(uv);
+            return albedo->getColorAt(uv, footprint);
+        }
+    }
+
+    // only microfacet reflection has an 8-lane form, other kernels are batched one direction at a time
+    template <uint Surf, uint Illu, bool Trans>
+    constexpr auto Material::selectKernel8() -> decltype(BSDFKernel::bsdf8) {
+        if constexpr (Illu == BSDF_MICROFACET && !(Trans && Surf != BSDF_DIFFUSE)) {
+            return &Material::bsdfKernel8<Surf, Illu, Trans>;
+        } else {
+            return nullptr;
+        }
+    }
+
+    template <uint Surf, uint Illu>
+    const Material::BSDFKernel* Material::selectKernel(bool transmissive) {
+        static const BSDFKernel kernels[2] = {
+            {&Material::bsdfKernel<Surf, Illu, false>, &Material::scatterKernel<Surf, false>, &Material::pdfKernel<Surf, false>, selectKernel8<Surf, Illu, false>()},
+            {&Material::bsdfKernel<Surf, Illu, true>, &Material::scatterKernel<Surf, true>, &Material::pdfKernel<Surf, true>, selectKernel8<Surf, Illu, true>()},
+        };
+        return &kernels[transmissive ? 1 : 0];
+    }
+
+    template <uint Surf>
+    const Material::BSDFKernel* Material::selectKernel(uint illuType, bool transmissive) {
+        switch (illuType) {
+            case BSDF_PHONG: return selectKernel<Surf, BSDF_PHONG>(transmissive);
+            case BSDF_BLINN_PHONG: return selectKernel<Surf, BSDF_BLINN_PHONG>(transmissive);
+            default: return selectKernel<Surf, BSDF_MICROFACET>(transmissive);
+        }
+    }
+
+    /**
+     * @brief Resolves the specialised BSDF kernels for a material type.
+     *
+     * Called once at load, so evaluation and sampling never decode the type masks again.
+     *
+     * @param type  [in] Combination of scatter, surface and illumination model bits.
+     *
+     * @return const BSDFKernel* Static kernel table entry for the type.
+     */
+    const Material::BSDFKernel* Material::resolveKernel(uint type) {
+        uint surfType = type & surfMask;
+        uint illuType = type & illuMask;
+        bool transmissive = type & BSDF_TRANSIMISSION;
+
+        switch (surfType) {
+            case BSDF_SPECULAR: return selectKernel<BSDF_SPECULAR>(illuType, transmissive);
+            case BSDF_GLOSSY: return selectKernel<BSDF_GLOSSY>(illuType, transmissive);
+            default: return selectKernel<BSDF_DIFFUSE>(illuType, transmissive);
         }
     }
 
@@ -117,18 +208,22 @@ namespace spt
      *         - Second: Probability density (PDF) of the sampled direction.
      */
     std::pair<Vec3<float>, float> Material::scatter(const Vec3<float> &V, const Vec3<float> &N) const {
-        // bsdf scatter type
-        uint scatType = type & scatMask;
+        return (this->*kernel->scatter)(V, N);
+    }
 
-        auto [L_t, PDF_t] = transmit(V, N);
-        auto [L_r, PDF_r] = reflect(V, N);
-        float prob = rand(1.f);
-        
-        if ((scatType & BSDF_TRANSIMISSION) && PDF_t > 0.f && prob < transparency) {
-            return {L_t, PDF_t};
-        } else {
-            return {L_r, PDF_r};
+    template <uint Surf, bool Trans>
+    std::pair<Vec3<float>, float> Material::scatterKernel(const Vec3<float> &V, const Vec3<float> &N) const {
+        // transmit() only samples specular and glossy surfaces; a total internal reflection
+        // is returned as a failed sample, so the lobe choice stays the one pdf() assumes
+        if constexpr (Trans && Surf != BSDF_DIFFUSE) {
+            if (rand(1.f) < transparency) {
+                return transmit<Surf>(V, N);
+            }
+            // reflect on the side of V, inside the medium too
+            return reflect<Surf>(V, dot(N, V) > 0 ? N : -N);
         }
+
+        return reflect<Surf>(V, N);
     }
 
     /**
@@ -141,61 +236,60 @@ namespace spt
      *         - First:  Sampled outgoing direction (L) pointing AWAY from the surface.
      *         - Second: Probability density (PDF) of the sampled direction.
      */
+    template <uint Surf>
     std::pair<Vec3<float>, float> Material::reflect(const Vec3<float> &V, const Vec3<float> &N) const {
         Vec3<float> L(0.f, 0.f, 0.f);
         float PDF = 0.f;
 
-        // bsdf surface type
-        uint surfType = type & surfMask;
-
-        switch (surfType) {
-            // perfect specular reflection
-            case BSDF_SPECULAR: {
-                // construct L
-                float NdotV = dot(N, V);
-                L = normalize(N * 2 * NdotV - V);
-                // validate
-                // assert(distance(normalize(V + L),  N) < EPSILON);
+        // perfect specular reflection
+        if constexpr (Surf == BSDF_SPECULAR) {
+            // construct L
+            float NdotV = dot(N, V);
+            L = normalize(N * 2 * NdotV - V);
+            // validate
+            // assert(distance(normalize(V + L),  N) < EPSILON);
 
-                // only one possible direction
-                PDF = 1.f;
-            }
-            break;
-            // glossy reflection (Mixture of GGX importance sampling and Cosine importance sampling)
-            case BSDF_GLOSSY: {
-                // higher roughness, higher diffuse probability
-                if (rand(1.f) < roughness) {
-                    // COSINE importance sampling
-                    L = sample(V, N, "COSINE");
-                
-                    float NdotL = dot(N, L);
-                    PDF = NdotL / PI;
-                } else {
-                    // GGX importance sampling
-                    Vec3<float> H = sample(V, N, "GGX");
-
-                    float HdotV = dot(H, V);
-                    float HdotN = dot(H, N);
-
-                    // construct L
-                    L = normalize(H * 2 * HdotV - V);
-
-                    // calculate L's pdf with the Jacobian of the reflection mapping
-                    float D = GGX_D(HdotN, roughness);
-                    float denom = std::max(4 * HdotV, EPSILON);
-                    PDF = D * HdotN / denom; 
-                }
-            }
-            break;
-            // diffuse reflection (COSINE importance sampling)
-            case BSDF_DIFFUSE: {
+            // only one possible direction
+            PDF = 1.f;
+        }
+        // glossy reflection (Mixture of GGX importance sampling and Cosine importance sampling)
+        if constexpr (Surf == BSDF_GLOSSY) {
+            // higher roughness, higher diffuse probability
+            if (rand(1.f) < roughness) {
                 // COSINE importance sampling
-                L = sample(V, N, "COSINE");
+                L = sample<SAMPLE_COSINE>(V, N);
             
                 float NdotL = dot(N, L);
-                PDF = NdotL / PI;            
+                PDF = NdotL / PI;
+            } else {
+                // GGX importance sampling
+                Vec3<float> H = sample<SAMPLE_GGX>(V, N);
+
+                float HdotV = dot(H, V);
+                float HdotN = dot(H, N);
+
+                // construct L
+                L = normalize(H * 2 * HdotV - V);
+
+                // calculate L's pdf with the Jacobian of the reflection mapping,
+                // facets turned away from V reflect nothing
+                float D = GGX_D(HdotN, alpha2);
+                float denom = std::max(4 * HdotV, EPSILON);
+                PDF = HdotV > 0 ? D * HdotN / denom : 0.f;
             }
-            break;
+        }
+        // diffuse reflection (COSINE importance sampling)
+        if constexpr (Surf == BSDF_DIFFUSE) {
+            // COSINE importance sampling
+            L = sample<SAMPLE_COSINE>(V, N);
+        
+            float NdotL = dot(N, L);
+            PDF = NdotL / PI;            
+        }
+
+        // glossy lobes may reach below the surface, pdf() gives those 0 as well
+        if (dot(N, L) <= 0) {
+            PDF = 0.f;
         }
 
         return {L, PDF};
@@ -213,22 +307,23 @@ namespace spt
      * 
      * @note Snell's law is sinThetaI / sinThetaT = iorT / iorI
      */
+    template <uint Surf>
     std::pair<Vec3<float>, float> Material::transmit(const Vec3<float> &V, const Vec3<float> &N) const {
         Vec3<float> L(0.f, 0.f, 0.f);
         float PDF = 0.f;
 
-        // construct transmission direction
-        auto constructL = [this](const Vec3<float>& V, const Vec3<float>& N) {
-            // cosine incident theta
-            float cosThetaI = dot(N, V); 
+        // ratio of incident ior to transmitted ior
+        // V on the side of N: oustide -> material
+        // otherwise: material -> outside
+        float eta = (dot(N, V) > 0) ? (1.0f / ior) : ior;
 
-            // create a 'temporary' normal, same hemishpere with V
-            Vec3<float> NN = (cosThetaI > 0) ? N : -N;
-
-            // ratio of incident ior to transmitted ior
-            // cosThetaI > 0: oustide -> material
-            // otherwise: material -> outside
-            float eta = (cosThetaI > 0) ? (1.0f / ior) : ior; 
+        // construct transmission direction through a facet with normal M on the side of V
+        auto constructL = [eta](const Vec3<float>& V, const Vec3<float>& M) {
+            // cosine incident theta
+            float cosThetaI = dot(M, V);
+            if (cosThetaI <= 0) {
+                return Vec3<float>{0.f, 0.f, 0.f};
+            }
 
             // square of sine transmitted theta
             float sin2ThetaT = eta * eta * (1 - cosThetaI * cosThetaI);
@@ -239,72 +334,141 @@ namespace spt
             // cosine transmitted theta
             float cosThetaT = sqrtf(1 - sin2ThetaT);
 
-            Vec3<float> L = - V * eta + N * (eta * cosThetaI - cosThetaT);
+            Vec3<float> L = - V * eta + M * (eta * cosThetaI - cosThetaT);
             return L;
         };
+        Vec3<float> NN = (dot(N, V) > 0) ? N : -N;
+
+        // perfect specular trasimission
+        if constexpr (Surf == BSDF_SPECULAR) {
+            // construct L
+            L = constructL(V, NN);
+            // only one possible direction
+            PDF = L == Vec3(0.f, 0.f, 0.f) ? 0.f : 1.f;
+        }
+        if constexpr (Surf == BSDF_GLOSSY) {
+            // GGX importance sampling
+            Vec3<float> H = sample<SAMPLE_GGX>(V, NN);
+
+            // construct L
+            L = constructL(V, H);
+
+            // a rough facet may refract back to the side of V, pdf() and the btdf leave that out
+            if (L != Vec3(0.f, 0.f, 0.f) && dot(L, NN) < 0) {
+                L = normalize(L);
+                // calculate L's pdf with the Jacobian of the refraction mapping
+                PDF = pdfTransmit<Surf>(V, N, L);
+            }
+        }
 
-        // bsdf surface type
-        uint surfType = type & surfMask;
+        return {L, PDF};
+    }
 
-        switch (surfType) {
-            // perfect specular trasimission
-            case BSDF_SPECULAR: {
-                // construct L
-                L = constructL(V, N);
-                // only one possible direction
-                PDF = L == Vec3(0.f, 0.f, 0.f) ? 0.f : 1.f;
-            }
-            break;
-            // TODO: fix BSDF_GLOSSY sample pdf calculation
-            case BSDF_GLOSSY: {
-                // GGX importance sampling
-                Vec3<float> H = sample(V, N, "GGX");
+    /**
+     * @brief Evaluates the PDF with which scatter() samples a given direction.
+     *
+     * Mirrors the lobe selection of scatter(), so it can be used as the BSDF strategy
+     * density in multiple importance sampling. Perfect specular lobes are delta
+     * distributions and evaluate to 0.
+     *
+     * @param V     [in] Outgoing view direction (pointing AWAY from the surface). Must be normalized.
+     * @param N     [in] Surface normal. Must be normalized.
+     * @param L     [in] Incident light direction (pointing AWAY from the surface). Must be normalized.
+     *
+     * @return float Probability density (solid angle measure) of sampling L.
+     */
+    float Material::pdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const {
+        return (this->*kernel->pdf)(V, N, L);
+    }
 
-                // construct L
-                L = constructL(V, H);
+    template <uint Surf, bool Trans>
+    float Material::pdfKernel(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const {
+        bool sameSide = dot(N, V) * dot(N, L) > 0;
 
-                if (L == Vec3(0.f, 0.f, 0.f)) {
-                    break;
-                }
-                // calculate L's pdf with the Jacobian of the reflection mapping
-                float HdotV = dot(H, V);
-                float HdotL = dot(H, L);
-                float HdotN = dot(H, N);
-                float eta = (HdotV > 0) ? (1.0f / ior) : ior;
-                float D = GGX_D(HdotN, roughness);
-                float nom = D * eta * eta * ::fabsf(HdotL);
-                float denom = std::max(::powf(eta * HdotV + HdotL, 2.f), EPSILON);
-                PDF = nom / denom; 
+        // transmit() only samples specular and glossy surfaces, otherwise scatter() always reflects
+        if constexpr (!Trans || Surf == BSDF_DIFFUSE) {
+            return sameSide ? pdfReflect<Surf>(V, N, L) : 0.f;
+        } else {
+            if (sameSide) {
+                return (1 - transparency) * pdfReflect<Surf>(V, dot(N, V) > 0 ? N : -N, L);
+            } else {
+                return transparency * pdfTransmit<Surf>(V, N, L);
             }
-            break;
         }
+    }
 
-        return {L, PDF};
+    template <uint Surf>
+    float Material::pdfReflect(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const {
+        float NdotL = dot(N, L);
+        if (NdotL <= 0) {
+            return 0.f;
+        }
+
+        if constexpr (Surf == BSDF_GLOSSY) {
+            Vec3<float> H = normalize(V + L);
+            float HdotV = ::fabsf(dot(H, V));
+            float HdotN = ::fabsf(dot(H, N));
+
+            float D = GGX_D(HdotN, alpha2);
+            float denom = std::max(4 * HdotV, EPSILON);
+            return roughness * NdotL / PI + (1 - roughness) * D * HdotN / denom;
+        } else if constexpr (Surf == BSDF_DIFFUSE) {
+            return NdotL / PI;
+        } else {
+            return 0.f;
+        }
+    }
+
+    template <uint Surf>
+    float Material::pdfTransmit(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L) const {
+        if constexpr (Surf != BSDF_GLOSSY) {
+            return 0.f;
+        } else {
+            // ratio of incident ior to transmitted ior
+            float eta = (dot(N, V) > 0) ? (1.0f / ior) : ior;
+
+            // generalized half vector, oriented with N
+            Vec3<float> H = V * eta + L;
+            if (H.length() < EPSILON) {
+                return 0.f;
+            }
+            H = normalize(H);
+            // facet on the side of V, as transmit() samples it
+            H = (dot(H, N) * dot(N, V) > 0) ? H : -H;
+
+            float HdotV = dot(H, V);
+            float HdotL = dot(H, L);
+            float HdotN = ::fabsf(dot(H, N));
+            if (HdotV <= 0 || HdotL >= 0) {
+                return 0.f;
+            }
+
+            float D = GGX_D(HdotN, alpha2);
+            float denom = (eta * HdotV + HdotL) * (eta * HdotV + HdotL);
+            denom = std::max(denom, EPSILON);
+            return D * HdotN * ::fabsf(HdotL) / denom;
+        }
     }
 
-    Vec3<float> Material::sample(const Vec3<float> &V, const Vec3<float> &N, const std::string& mode) const {
+    template <SampleMode Mode>
+    Vec3<float> Material::sample(const Vec3<float> &V, const Vec3<float> &N) const {
         float a = rand(1.f), b = rand(1.f);
 
         // local sampling direction
         Vec3<float> localDir(0.f, 0.f, 0.f);
 
-        if (mode == "GGX") {
-            float alpha = roughness * roughness;
-            float alpha2 = alpha * alpha;
-
+        if constexpr (Mode == SAMPLE_GGX) {
             float cosTheta = sqrtf((1 - a) / (1 + (alpha2 - 1) * a));
             float sinTheta = sqrtf(1 - cosTheta * cosTheta);
             float Phi = 2 * PI * b;
 
             localDir = {cosf(Phi) * sinTheta, sinf(Phi) * sinTheta, cosTheta};
-        } else if (mode == "COSINE") {
+        } else {
             float cosTheta = sqrtf(a);
             float sinTheta = sqrtf(1 - cosTheta * cosTheta);
             float Phi =  2 * PI * b;
 
             localDir = {cosf(Phi) * sinTheta, sinf(Phi) * sinTheta, cosTheta};
-        } else {
-            return localDir; // return default
         }
 
         // orthogonal basis
@@ -323,26 +487,32 @@ namespace spt
      * @param N     [in] Surface normal. Must be normalized.
      * @param L     [in] Incident light direction (pointing AWAY from the surface). Must be normalized.
      * @param UV    [in] Texture coordinates.
+     * @param footprint [in] Ray cone width in uv units, selects the texture mip level.
      * 
      * @return Vec3<float> The computed BSDF value.
      */
-    Vec3<float> Material::bsdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec2<float>& UV) const {
+    Vec3<float> Material::bsdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec2<float>& UV, float footprint) const {
+        return (this->*kernel->bsdf)(V, N, L, UV, footprint);
+    }
+
+    template <uint Surf, uint Illu, bool Trans>
+    Vec3<float> Material::bsdfKernel(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec2<float>& UV, float footprint) const {
         Vec3<float> bsdf(0, 0, 0);
 
         // reflection
-        if ((type & BSDF_REFLECTION)) {
+        {
             // half vector
             Vec3<float> H = normalize(V + L);
 
             // make sure V, L, N, H in the same hemisphere
             if (dot(V, N) > 0 && dot(L, N) > 0) {
                 // brdf
-                bsdf += brdf(V, N, L, H, UV);
+                bsdf += brdf<Surf, Illu>(V, N, L, H, UV, footprint);
             }
         } 
 
-        // transimission
-        if ((type & BSDF_TRANSIMISSION)) {
+        // transimission (diffuse surfaces have no btdf)
+        if constexpr (Trans && Surf != BSDF_DIFFUSE) {
             // create a 'temporary' normal, same hemishpere with V
             Vec3<float> NN = (dot(N, V) > 0) ? N : -N;
 
@@ -364,13 +534,110 @@ namespace spt
             // also make sure transmission happens
             if (dot(V, NN) > 0 && dot(L, NN) < 0 && dot(V, H) > 0 && dot(L, H) < 0) {
                 // btdf
-                bsdf += btdf(V, NN, L, H, UV, eta);
+                bsdf += btdf<Surf>(V, NN, L, H, UV, eta);
             }
         }
 
         return bsdf;
     }
 
+    /**
+     * @brief Evaluates the BSDF for several incident directions at the same shading point.
+     *
+     * Directions are processed in batches of 8 lanes, so light samples of all groups
+     * share a single texture lookup and run through the vectorised microfacet lobe.
+     * Kernels without an 8-lane form, and a lone remaining direction, run scalar.
+     *
+     * @param V     [in] Outgoing view direction (pointing AWAY from the surface). Must be normalized.
+     * @param N     [in] Surface normal. Must be normalized.
+     * @param L     [in] Incident light directions (pointing AWAY from the surface). Must be normalized.
+     * @param count [in] Number of directions in L.
+     * @param UV    [in] Texture coordinates.
+     * @param out   [out] BSDF value of each direction, at least count entries.
+     * @param footprint [in] Ray cone width in uv units, selects the texture mip level.
+     */
+    void Material::bsdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float>* L, size_t count, const Vec2<float>& UV, Vec3<float>* out, float footprint) const {
+        size_t i = 0;
+        if (kernel->bsdf8 != nullptr) {
+            while (count - i > 1) {
+                size_t n = std::min<size_t>(8, count - i);
+
+                // pad the last batch with a direction below the surface
+                Vec3<float> lanes[8];
+                for (size_t j = 0; j < 8; j++) {
+                    lanes[j] = j < n ? L[i + j] : -N;
+                }
+
+                (this->*kernel->bsdf8)(V, N, lanes, UV, lanes, footprint);
+                std::copy(lanes, lanes + n, out + i);
+                i += n;
+            }
+        }
+
+        // a single direction, or a kernel without an 8-lane form
+        for (; i < count; i++) {
+            out[i] = (this->*kernel->bsdf)(V, N, L[i], UV, footprint);
+        }
+    }
+
+    // 8-lane GGX_D, Fresnel_Schlick and Smith_G of the batched kernels
+    static Float8 GGX_D8(const Float8& NdotH, float alpha2) {
+        Float8 denom = fmadd(NdotH * NdotH, alpha2 - 1.0f, 1.0f);
+        return Float8(alpha2) / (denom * denom * PI);
+    }
+
+    static Vec3x8 Fresnel_Schlick8(const Float8& cosTheta, const Vec3<float>& F0) {
+        Float8 m = Float8(1.0f) - cosTheta;
+        Float8 m2 = m * m;
+        Float8 m5 = m2 * m2 * m;
+        return Vec3x8(fmadd(m5, 1.f - F0.x, F0.x), fmadd(m5, 1.f - F0.y, F0.y), fmadd(m5, 1.f - F0.z, F0.z));
+    }
+
+    static Float8 Smith_G8(float NdotV, const Float8& NdotL, float k) {
+        float ggx1 = NdotV / (NdotV * (1.0f - k) + k);
+        Float8 ggx2 = NdotL / fmadd(NdotL, 1.0f - k, k);
+        return ggx2 * ggx1;
+    }
+
+    template <uint Surf, uint Illu, bool Trans>
+    void Material::bsdfKernel8(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float>* dirs, const Vec2<float>& UV, Vec3<float>* out, float footprint) const {
+        float NdotV = dot(N, V);
+        if (NdotV <= 0) {
+            std::fill(out, out + 8, Vec3(0.f, 0.f, 0.f));
+            return;
+        }
+        Vec3x8 L = Vec3x8::load(dirs);
+
+        // mtl info, shared by all lanes
+        Vec3<float> baseColor = getBaseColor(UV, footprint);
+        Vec3<float> F0 = Vec3(f0, f0, f0) + baseColor * metallic;
+
+        // cosine constants
+        Vec3x8 Vs(V), Ns(N);
+        Vec3x8 H = normalize(Vs + L);
+        Float8 NdotL = dot(Ns, L);
+        Float8 NdotH = dot(Ns, H);
+        Float8 VdotH = dot(Vs, H);
+
+        Vec3x8 F = Fresnel_Schlick8(VdotH, F0);
+        Vec3x8 NF = Vec3x8(Vec3(1.f, 1.f, 1.f)) - F;
+
+        Vec3x8 brdf;
+        if constexpr (Surf == BSDF_DIFFUSE) {
+            brdf = NF * Vec3x8(baseColor * ((1 - metallic) * (1 - transparency) / PI));
+        } else if constexpr (Surf == BSDF_GLOSSY) {
+            Float8 D = GGX_D8(NdotH, alpha2);
+            Float8 G = Smith_G8(NdotV, NdotL, k);
+            Float8 denom = max(NdotL * (4.0f * NdotV), EPSILON);
+            brdf = NF * Vec3x8(baseColor * ((1 - metallic) / PI)) + F * (D * G / denom);
+        } else {
+            brdf = F * Vec3x8(baseColor / PI / NdotV);
+        }
+
+        // lanes below the surface contribute nothing
+        select(NdotL > 0.f, brdf, Vec3x8(Vec3(0.f, 0.f, 0.f))).store(out);
+    }
+
     /**
      * @brief Evaluates the BRDF (Bidirectional Reflectance Distribution Function) for a given material.
      *
@@ -379,69 +646,56 @@ namespace spt
      * @param L   [in] Light direction (pointing AWAY from the surface). Must be normalized.
      * @param H   [in] Half-vector (normalized midpoint between V and L). Must be normalized.
      * @param UV  [in] Texture coordinates.
+     * @param footprint [in] Ray cone width in uv units, selects the texture mip level.
      *
      * @return Vec3<float> The BRDF value (RGB color) for the given input directions.
      * 
      * @note All direction vectors (V, N, L, H) in the SAME hemisphere.
      */
-    Vec3<float> Material::brdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV) const {
-        // brdf surface type
-        uint surfType = type & surfMask;
-
-        // bsdf illumination model
-        uint illuType = type & illuMask;
+    template <uint Surf, uint Illu>
+    Vec3<float> Material::brdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV, float footprint) const {
+        constexpr bool phong = Illu == BSDF_PHONG || Illu == BSDF_BLINN_PHONG;
 
         // mtl info
-        Vec3<float> baseColor = getBaseColor(UV);
+        Vec3<float> baseColor = getBaseColor(UV, footprint);
     
         // cosine constants
         float NdotL = dot(N, L);
         float NdotV = dot(N, V);
         float NdotH = dot(N, H);
-        float LdotH = dot(L, H);
         float VdotH = dot(V, H);
         
         // all the directions must be in same hemisphere
         assert(NdotL >= 0 && NdotV >= 0 && NdotH >= 0);
-        
-        Vec3<float> F0(0.04f, 0.04f, 0.04f);
-        F0 = F0 * (1 - metallic) + baseColor * metallic; // mix
-    
-        float D = GGX_D(NdotH, roughness);
-        float G = Smith_G(NdotV, NdotL, roughness);
-        Vec3<float> F = Fresnel_Schlick(VdotH, F0); 
-        Vec3<float> NF = (Vec3(1.f, 1.f, 1.f) - F);
 
-        switch (surfType) {
-            case BSDF_DIFFUSE: {
-                if (illuType == BSDF_PHONG || illuType == BSDF_BLINN_PHONG) {
-                    return baseColor;
-                } else {
-                    return NF * (1 - metallic) * (1 - transparency) * baseColor / PI;
-                }
-            }
-            case BSDF_GLOSSY: {
-                if (illuType == BSDF_PHONG) {
-                    // ideal reflected direction
-                    Vec3<float> R = N * 2 * NdotL - L;
-                    float VdotR = dot(V, R);
-                    return baseColor + specular * shininess * ::powf(VdotR, shininess);
-                } else if (illuType == BSDF_BLINN_PHONG) {
-                    return baseColor + specular * shininess * ::powf(NdotH, shininess);
-                } else {
-                    float denom = std::max(4.0f * NdotV * NdotL, EPSILON);
-                    return NF * (1 - metallic) * baseColor / PI + F * D * G / denom;
-                }
-            }
-            case BSDF_SPECULAR: {
+        if constexpr (Surf == BSDF_DIFFUSE && phong) {
+            return baseColor;
+        } else if constexpr (Surf == BSDF_GLOSSY && Illu == BSDF_PHONG) {
+            // ideal reflected direction
+            Vec3<float> R = N * 2 * NdotL - L;
+            float VdotR = dot(V, R);
+            return baseColor + specular * shininess * ::powf(VdotR, shininess);
+        } else if constexpr (Surf == BSDF_GLOSSY && Illu == BSDF_BLINN_PHONG) {
+            return baseColor + specular * shininess * ::powf(NdotH, shininess);
+        } else {
+            Vec3<float> F0 = Vec3(f0, f0, f0) + baseColor * metallic; // mix
+
+            Vec3<float> F = Fresnel_Schlick(VdotH, F0); 
+            Vec3<float> NF = (Vec3(1.f, 1.f, 1.f) - F);
+
+            if constexpr (Surf == BSDF_DIFFUSE) {
+                return NF * (1 - metallic) * (1 - transparency) * baseColor / PI;
+            } else if constexpr (Surf == BSDF_GLOSSY) {
+                float D = GGX_D(NdotH, alpha2);
+                float G = Smith_G(NdotV, NdotL, k);
+                float denom = std::max(4.0f * NdotV * NdotL, EPSILON);
+                return NF * (1 - metallic) * baseColor / PI + F * D * G / denom;
+            } else {
                 // H should be same as N for perfect reflection
                 // assert(distance(N, H) < EPSILON);
 
                 return F * (baseColor / PI) / NdotV;
             }
-            default: {
-                return Vec3(0.f, 0.f, 0.f);
-            }
         }
     }
 
@@ -458,13 +712,8 @@ namespace spt
      * 
      * @note V and N are in the SAME hemisphere (V·N ≥ 0), while L is in the OPPOSITE hemisphere (L·N ≤ 0).
      */
+    template <uint Surf>
     Vec3<float> Material::btdf(const Vec3<float> &V, const Vec3<float> &N, const Vec3<float> &L, const Vec3<float>& H, const Vec2<float>& UV, float eta) const {
-        // btdf surface type
-        uint surfType = type & surfMask;
-
-        // mtl info
-        Vec3<float> baseColor = getBaseColor(UV);
-    
         // cosine constants
         float NdotL = dot(N, L);
         float NdotV = dot(N, V);
@@ -475,34 +724,27 @@ namespace spt
         // make sure V, H, N are in the same hemisphere, while L in the opposite one
         assert(NdotL <= 0 && NdotV >= 0 && NdotH >= 0);
         
-        Vec3<float> F0(eta, eta, eta);
-        F0 = pow((F0 - Vec3(1.f, 1.f, 1.f)) / (F0 + Vec3(1.f, 1.f, 1.f)), 2.f);
+        Vec3<float> F0(f0Eta, f0Eta, f0Eta);
 
-        float D = GGX_D(NdotH, roughness);
-        float G = Smith_G(NdotV, ::fabsf(NdotL), roughness);
         Vec3<float> F = Fresnel_Schlick(VdotH, F0); 
         Vec3<float> NF = (Vec3(1.f, 1.f, 1.f) - F);
 
-        switch (surfType) {
-            case BSDF_SPECULAR: {
-                // H should be same as N for perfect transmission
-                // assert(distance(N, H) < EPSILON);
-                return NF * transparency / (eta * eta * VdotH);
-            }
-            case BSDF_GLOSSY: {
-                float denom = std::max(::powf(eta * VdotH + LdotH, 2.f) * fabsf(NdotV * NdotL), EPSILON);
-                Vec3<float> nom = NF * D * G * eta * eta * transparency * fabsf(VdotH * LdotH);
-                return nom / denom;
-            }
-            default: {
-                return Vec3(0.f, 0.f, 0.f);
-            }
+        if constexpr (Surf == BSDF_SPECULAR) {
+            // H should be same as N for perfect transmission
+            // assert(distance(N, H) < EPSILON);
+            return NF * transparency / (eta * eta * VdotH);
+        } else if constexpr (Surf == BSDF_GLOSSY) {
+            float D = GGX_D(NdotH, alpha2);
+            float G = Smith_G(NdotV, ::fabsf(NdotL), k);
+            float denom = std::max((eta * VdotH + LdotH) * (eta * VdotH + LdotH) * fabsf(NdotV * NdotL), EPSILON);
+            Vec3<float> nom = NF * D * G * eta * eta * transparency * fabsf(VdotH * LdotH);
+            return nom / denom;
+        } else {
+            return Vec3(0.f, 0.f, 0.f);
         }
     }
 
-    float Material::GGX_D(float NdotH, float roughness) {
-        float alpha = roughness * roughness;
-        float alpha2 = alpha * alpha;
+    float Material::GGX_D(float NdotH, float alpha2) {
         float NdotH2 = NdotH * NdotH;
         
         float denom = NdotH2 * (alpha2 - 1.0f) + 1.0f;
@@ -511,15 +753,14 @@ namespace spt
     }
 
     Vec3<float> Material::Fresnel_Schlick(float cosTheta, const Vec3<float>& F0) {
-        return F0 + (Vec3<float>(1.f, 1.f, 1.f) - F0) * ::powf(1.0f - cosTheta, 5.0f);
+        float m = 1.0f - cosTheta;
+        float m2 = m * m;
+        return F0 + (Vec3<float>(1.f, 1.f, 1.f) - F0) * (m2 * m2 * m);
     }
 
-    float  Material::Smith_G(float NdotV, float NdotL, float roughness) {
-        // SIGGRAPH 2013：UE4
-        auto GeometrySchlickGGX = [roughness](float cosTheta) {
-            float r = (roughness + 1.0f);
-            float k = (r * r) / 8.0f;
-            
+    float  Material::Smith_G(float NdotV, float NdotL, float k) {
+        // SIGGRAPH 2013：UE4, k = (roughness + 1)^2 / 8
+        auto GeometrySchlickGGX = [k](float cosTheta) {
             float nom = cosTheta;
             float denom = cosTheta * (1.0f - k) + k;
             
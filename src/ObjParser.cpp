@@ -0,0 +1,472 @@
+#include "ObjParser.hpp"
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fcntl.h>
+#include <fstream>
+#include <functional>
+#include <map>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spt {
+
+// one line-aligned piece of the file, indices are chunk-relative where marked in fixups
+struct ObjChunk {
+  const char* begin;
+  const char* end;
+
+  std::vector<float> vertices, texcoords, normals;
+  std::vector<tinyobj::index_t> indices; // triangulated, 3 per triangle
+  std::vector<int> materials; // per triangle, slot in materialNames, -1 keeps the material before the chunk
+  std::vector<std::string> materialNames;
+  int lastMaterial = -1; // slot in effect at the end, for the chunks after
+  std::vector<std::pair<size_t, std::string>> groups; // o and g lines, first triangle of the shape and its name
+  std::vector<std::vector<std::string>> mtllibs;
+  std::vector<size_t> fixups; // 3 * index + component of negative indices, counted from the chunk's first element
+  size_t skipped = 0; // faces with fewer than 3 vertices
+  size_t line = 0; // first bad line, for the error
+  bool ok = true;
+
+  ObjChunk(const char* b, const char* e) : begin(b), end(e) {}
+};
+
+static inline bool isSpace(char c) {
+  return c == ' ' || c == '\t';
+}
+
+static inline const char* skipSpace(const char* p, const char* end) {
+  while (p < end && isSpace(*p)) {
+    p++;
+  }
+  return p;
+}
+
+// decimal float without strtod, locale and allocation: [sign] digits [. digits] [e [sign] digits]
+static const char* parseFloat(const char* p, const char* end, float& value) {
+  static const double POW10[] = {1e0,  1e1,  1e2,  1e3,  1e4,  1e5,  1e6,  1e7,  1e8,  1e9,  1e10, 1e11,
+                                 1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+
+  // up to 19 significant digits in the mantissa, the rest only shift the exponent
+  uint64_t mantissa = 0;
+  int exponent = 0, digits = 0;
+  bool any = false;
+  for (; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+    if (digits < 19) {
+      mantissa = mantissa * 10 + (*p - '0');
+      digits += mantissa != 0;
+    } else {
+      exponent++;
+    }
+  }
+  if (p < end && *p == '.') {
+    for (p++; p < end && *p >= '0' && *p <= '9'; p++, any = true) {
+      if (digits < 19) {
+        mantissa = mantissa * 10 + (*p - '0');
+        digits += mantissa != 0;
+        exponent--;
+      }
+    }
+  }
+  if (!any) {
+    return nullptr;
+  }
+  if (p < end && (*p == 'e' || *p == 'E')) {
+    const char* q = p + 1;
+    bool expNegative = false;
+    if (q < end && (*q == '-' || *q == '+')) {
+      expNegative = *q == '-';
+      q++;
+    }
+    if (q < end && *q >= '0' && *q <= '9') {
+      int e = 0;
+      for (; q < end && *q >= '0' && *q <= '9'; q++) {
+        e = std::min(e * 10 + (*q - '0'), 10000);
+      }
+      exponent += expNegative ? -e : e;
+      p = q;
+    }
+  }
+
+  double v = double(mantissa);
+  if (mantissa != 0 && exponent != 0) {
+    if (exponent > 0 && exponent <= 22) {
+      v *= POW10[exponent];
+    } else if (exponent < 0 && exponent >= -22) {
+      v /= POW10[-exponent];
+    } else {
+      v *= std::pow(10.0, exponent);
+    }
+  }
+  value = float(negative ? -v : v);
+  return p;
+}
+
+static inline const char* parseInt(const char* p, const char* end, int& value) {
+  bool negative = false;
+  if (p < end && (*p == '-' || *p == '+')) {
+    negative = *p == '-';
+    p++;
+  }
+  if (p >= end || *p < '0' || *p > '9') {
+    return nullptr;
+  }
+  long long v = 0;
+  for (; p < end && *p >= '0' && *p <= '9'; p++) {
+    v = std::min(v * 10 + (*p - '0'), 1LL << 40);
+  }
+  value = int(std::max(std::min(negative ? -v : v, (long long)INT32_MAX), (long long)INT32_MIN));
+  return p;
+}
+
+// rest of the line without surrounding blanks
+static std::string restOfLine(const char* p, const char* end) {
+  p = skipSpace(p, end);
+  while (end > p && isSpace(end[-1])) {
+    end--;
+  }
+  return std::string(p, end);
+}
+
+// up to 3 floats, missing ones keep their defaults
+static bool parseFloats(const char* p, const char* end, float* values, int count, int required) {
+  for (int i = 0; i < count; i++) {
+    p = skipSpace(p, end);
+    const char* q = (p < end) ? parseFloat(p, end, values[i]) : nullptr;
+    if (q == nullptr) {
+      return i >= required;
+    }
+    p = q;
+  }
+  return true;
+}
+
+ObjParser::ObjParser() : fd(-1), data(nullptr), size(0) {}
+
+ObjParser::~ObjParser() {
+  if (data != nullptr) {
+    ::munmap(const_cast<char*>(data), size);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+bool ObjParser::open(const std::string& fileName, size_t chunkBytes) {
+  fd = ::open(fileName.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || ::fstat(fd, &st) != 0) {
+    return false;
+  }
+  size = size_t(st.st_size);
+  if (size == 0) {
+    return true;
+  }
+
+  void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    size = 0;
+    return false;
+  }
+  data = static_cast<const char*>(mapped);
+  ::madvise(mapped, size, MADV_SEQUENTIAL);
+
+  // borders move to the next line start, so no line is split
+  size_t count = std::max<size_t>(1, (size + chunkBytes - 1) / std::max<size_t>(chunkBytes, 1));
+  const char* end = data + size;
+  const char* begin = data;
+  for (size_t i = 1; i <= count && begin < end; i++) {
+    const char* border = (i == count) ? end : data + size * i / count;
+    border = std::max(border, begin);
+    while (border < end && border[-1] != '\n') {
+      border++;
+    }
+    if (border > begin) {
+      chunks.push_back(std::make_unique<ObjChunk>(begin, border));
+    }
+    begin = border;
+  }
+  return true;
+}
+
+void ObjParser::parseChunk(size_t i) {
+  ObjChunk& chunk = *chunks[i];
+  const char* p = chunk.begin;
+  const char* end = chunk.end;
+  int material = -1;
+
+  // one face's corners, and which of their components are relative
+  std::vector<tinyobj::index_t> face;
+  std::vector<uint8_t> relative;
+
+  for (size_t line = 0; p < end; line++) {
+    const char* lineEnd = static_cast<const char*>(memchr(p, '\n', end - p));
+    lineEnd = (lineEnd == nullptr) ? end : lineEnd;
+    const char* next = (lineEnd < end) ? lineEnd + 1 : end;
+    if (lineEnd > p && lineEnd[-1] == '\r') {
+      lineEnd--;
+    }
+    const char* s = skipSpace(p, lineEnd);
+    p = next;
+    size_t n = lineEnd - s;
+    if (n < 2) {
+      continue;
+    }
+
+    bool ok = true;
+    if (s[0] == 'v' && isSpace(s[1])) {
+      float v[3] = {0.f, 0.f, 0.f};
+      ok = parseFloats(s + 2, lineEnd, v, 3, 3);
+      chunk.vertices.insert(chunk.vertices.end(), v, v + 3);
+    } else if (s[0] == 'v' && s[1] == 't' && n > 2 && isSpace(s[2])) {
+      float v[2] = {0.f, 0.f};
+      ok = parseFloats(s + 3, lineEnd, v, 2, 1);
+      chunk.texcoords.insert(chunk.texcoords.end(), v, v + 2);
+    } else if (s[0] == 'v' && s[1] == 'n' && n > 2 && isSpace(s[2])) {
+      float v[3] = {0.f, 0.f, 0.f};
+      ok = parseFloats(s + 3, lineEnd, v, 3, 3);
+      chunk.normals.insert(chunk.normals.end(), v, v + 3);
+    } else if (s[0] == 'f' && isSpace(s[1])) {
+      // v, v/vt, v//vn or v/vt/vn corners; negative indices count back from the current element
+      int counts[3] = {int(chunk.vertices.size() / 3), int(chunk.texcoords.size() / 2), int(chunk.normals.size() / 3)};
+      face.clear();
+      relative.clear();
+      const char* q = s + 2;
+      while (ok) {
+        q = skipSpace(q, lineEnd);
+        if (q >= lineEnd) {
+          break;
+        }
+        int idx[3] = {0, 0, 0};
+        bool given[3] = {true, false, false};
+        q = parseInt(q, lineEnd, idx[0]);
+        for (int c = 1; c < 3 && q != nullptr && q < lineEnd && *q == '/'; c++) {
+          q++;
+          if (q < lineEnd && *q != '/' && !isSpace(*q)) {
+            q = parseInt(q, lineEnd, idx[c]);
+            given[c] = q != nullptr;
+          }
+        }
+        if (q == nullptr || (q < lineEnd && !isSpace(*q))) {
+          ok = false;
+          break;
+        }
+
+        int resolved[3] = {-1, -1, -1};
+        uint8_t mask = 0;
+        for (int c = 0; c < 3; c++) {
+          if (!given[c]) {
+            continue;
+          }
+          if (idx[c] == 0) {
+            ok = false;
+          } else if (idx[c] > 0) {
+            resolved[c] = idx[c] - 1;
+          } else {
+            resolved[c] = counts[c] + idx[c];
+            mask |= uint8_t(1 << c);
+          }
+        }
+        tinyobj::index_t corner;
+        corner.vertex_index = resolved[0];
+        corner.texcoord_index = resolved[1];
+        corner.normal_index = resolved[2];
+        face.push_back(corner);
+        relative.push_back(mask);
+      }
+      if (!ok) {
+        // reported below
+      } else if (face.size() < 3) {
+        chunk.skipped++;
+      } else {
+        // fan triangulation, as tinyobj does
+        for (size_t k = 2; k < face.size(); k++) {
+          for (size_t corner : {size_t(0), k - 1, k}) {
+            for (int c = 0; c < 3; c++) {
+              if (relative[corner] & (1 << c)) {
+                chunk.fixups.push_back(chunk.indices.size() * 3 + c);
+              }
+            }
+            chunk.indices.push_back(face[corner]);
+          }
+          chunk.materials.push_back(material);
+        }
+      }
+    } else if ((s[0] == 'g' || s[0] == 'o') && isSpace(s[1])) {
+      chunk.groups.emplace_back(chunk.materials.size(), restOfLine(s + 2, lineEnd));
+    } else if (n > 6 && strncmp(s, "usemtl", 6) == 0 && isSpace(s[6])) {
+      chunk.materialNames.push_back(restOfLine(s + 7, lineEnd));
+      material = int(chunk.materialNames.size()) - 1;
+      chunk.lastMaterial = material;
+    } else if (n > 6 && strncmp(s, "mtllib", 6) == 0 && isSpace(s[6])) {
+      std::vector<std::string> names;
+      const char* q = skipSpace(s + 7, lineEnd);
+      while (q < lineEnd) {
+        const char* e = q;
+        while (e < lineEnd && !isSpace(*e)) {
+          e++;
+        }
+        names.emplace_back(q, e);
+        q = skipSpace(e, lineEnd);
+      }
+      chunk.mtllibs.push_back(std::move(names));
+    }
+
+    if (!ok && chunk.ok) {
+      chunk.ok = false;
+      chunk.line = line;
+    }
+  }
+}
+
+bool ObjParser::finish(const std::string& dir, tinyobj::attrib_t& attrib, std::vector<tinyobj::shape_t>& shapes,
+                       std::vector<tinyobj::material_t>& materials, std::string& warn, std::string& err) {
+  // the first bad line, numbered across the chunks before it
+  size_t lines = 0;
+  for (const auto& chunk : chunks) {
+    if (!chunk->ok) {
+      err += "Cannot parse line " + std::to_string(lines + chunk->line + 1) + "\n";
+      return false;
+    }
+    lines += std::count(chunk->begin, chunk->end, '\n');
+  }
+
+  // materials of every mtllib line in file order, the first file of a line that opens
+  std::map<std::string, int> materialMap;
+  for (const auto& chunk : chunks) {
+    for (const auto& names : chunk->mtllibs) {
+      bool found = false;
+      for (const std::string& name : names) {
+        std::ifstream stream(dir + name);
+        if (stream) {
+          tinyobj::LoadMtl(&materialMap, &materials, &stream, &warn, &err);
+          found = true;
+          break;
+        }
+      }
+      if (!found) {
+        warn += "Material file not found (line: mtllib";
+        for (const std::string& name : names) {
+          warn += ' ' + name;
+        }
+        warn += ")\n";
+      }
+    }
+  }
+
+  // element arrays concatenate, chunk-relative indices get the counts before the chunk
+  size_t totals[3] = {0, 0, 0};
+  for (const auto& chunk : chunks) {
+    totals[0] += chunk->vertices.size();
+    totals[1] += chunk->texcoords.size();
+    totals[2] += chunk->normals.size();
+  }
+  attrib.vertices.reserve(attrib.vertices.size() + totals[0]);
+  attrib.texcoords.reserve(attrib.texcoords.size() + totals[1]);
+  attrib.normals.reserve(attrib.normals.size() + totals[2]);
+
+  tinyobj::shape_t shape;
+  int material = -1;
+  size_t skipped = 0;
+  for (auto& chunk : chunks) {
+    int bases[3] = {int(attrib.vertices.size() / 3), int(attrib.texcoords.size() / 2), int(attrib.normals.size() / 3)};
+    attrib.vertices.insert(attrib.vertices.end(), chunk->vertices.begin(), chunk->vertices.end());
+    attrib.texcoords.insert(attrib.texcoords.end(), chunk->texcoords.begin(), chunk->texcoords.end());
+    attrib.normals.insert(attrib.normals.end(), chunk->normals.begin(), chunk->normals.end());
+
+    std::vector<tinyobj::index_t>& indices = chunk->indices;
+    for (size_t slot : chunk->fixups) {
+      tinyobj::index_t& index = indices[slot / 3];
+      int c = int(slot % 3);
+      (c == 0 ? index.vertex_index : c == 1 ? index.texcoord_index : index.normal_index) += bases[c];
+    }
+
+    // usemtl slots to material ids, unknown names get -1 as with tinyobj
+    std::vector<int> ids(chunk->materialNames.size(), -1);
+    for (size_t k = 0; k < ids.size(); k++) {
+      auto itr = materialMap.find(chunk->materialNames[k]);
+      if (itr != materialMap.end()) {
+        ids[k] = itr->second;
+      } else {
+        warn += "Material not found (name: " + chunk->materialNames[k] + ")\n";
+      }
+    }
+
+    // a group line closes the shape so far if it has faces
+    size_t triangles = chunk->materials.size();
+    size_t group = 0;
+    for (size_t t = 0; t <= triangles; t++) {
+      for (; group < chunk->groups.size() && chunk->groups[group].first == t; group++) {
+        if (!shape.mesh.indices.empty()) {
+          shapes.push_back(std::move(shape));
+          shape = tinyobj::shape_t();
+        }
+        shape.name = chunk->groups[group].second;
+      }
+      if (t == triangles) {
+        break;
+      }
+      if (chunk->materials[t] >= 0) {
+        material = ids[chunk->materials[t]];
+      }
+      shape.mesh.indices.insert(shape.mesh.indices.end(), indices.begin() + t * 3, indices.begin() + t * 3 + 3);
+      shape.mesh.num_face_vertices.push_back(3);
+      shape.mesh.material_ids.push_back(material);
+    }
+    if (chunk->lastMaterial >= 0) {
+      material = ids[chunk->lastMaterial];
+    }
+    skipped += chunk->skipped;
+
+    // parsed data is dropped as soon as it is merged
+    chunk.reset(new ObjChunk(nullptr, nullptr));
+  }
+  if (!shape.mesh.indices.empty()) {
+    shapes.push_back(std::move(shape));
+  }
+  if (skipped > 0) {
+    warn += std::to_string(skipped) + " faces with fewer than 3 vertices skipped\n";
+  }
+
+  // positions must exist, texture coordinates and normals out of range are ignored by the loader
+  int vertexCount = int(attrib.vertices.size() / 3);
+  for (const auto& s : shapes) {
+    for (const auto& index : s.mesh.indices) {
+      if (index.vertex_index < 0 || index.vertex_index >= vertexCount) {
+        err += "Vertex index out of range (shape: " + s.name + ")\n";
+        return false;
+      }
+    }
+  }
+  return true;
+}
+
+bool ObjParser::load(const std::string& fileName, const std::string& dir, ThreadPool& pool, tinyobj::attrib_t& attrib,
+                     std::vector<tinyobj::shape_t>& shapes, std::vector<tinyobj::material_t>& materials,
+                     std::string& warn, std::string& err) {
+  ObjParser parser;
+  if (!parser.open(fileName)) {
+    err += "Cannot open file (file: " + fileName + ")\n";
+    return false;
+  }
+
+  auto group = std::make_shared<TaskGroup>();
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < parser.getChunkCount(); i++) {
+    tasks.push_back([&parser, i] { parser.parseChunk(i); });
+  }
+  pool.submit(std::move(tasks), group);
+  pool.wait(*group);
+  return parser.finish(dir, attrib, shapes, materials, warn, err);
+}
+
+}  // namespace spt
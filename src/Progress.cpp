@@ -0,0 +1,80 @@
+#include "Progress.hpp"
+
+#include <algorithm>
+#include <cstdio>
+
+namespace spt {
+
+Progress::Progress(uint64_t totalSamples, float timeBudget, bool quietMode, float interval)
+    : samples(0), rays(0), total(totalSamples), budget(timeBudget), quiet(quietMode),
+      start(std::chrono::steady_clock::now()), stopping(false) {
+  if (!quiet) {
+    reporter = std::thread(&Progress::run, this, interval);
+  }
+}
+
+Progress::~Progress() {
+  finish();
+}
+
+float Progress::getElapsed() const {
+  return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+}
+
+float Progress::getFraction() const {
+  float fraction = 0.f;
+  if (budget > 0.f) {
+    fraction = getElapsed() / budget;
+  } else if (total > 0) {
+    fraction = float(double(getSamples()) / total);
+  }
+  return std::min(fraction, 1.f);
+}
+
+void Progress::run(float interval) {
+  auto period = std::chrono::duration<float>(interval);
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!wake.wait_for(lock, period, [this] { return stopping; })) {
+    print(false);
+  }
+}
+
+void Progress::finish() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (stopping) {
+      return;
+    }
+    stopping = true;
+  }
+  wake.notify_all();
+  if (reporter.joinable()) {
+    reporter.join();
+    print(true);
+  }
+}
+
+// one line, redrawn in place until the final call
+void Progress::print(bool final) const {
+  const int barWidth = 50;
+  float fraction = final ? 1.f : getFraction();
+  float elapsed = std::max(getElapsed(), 1e-6f);
+
+  char bar[barWidth + 1];
+  int pos = static_cast<int>(barWidth * fraction);
+  for (int i = 0; i < barWidth; ++i) {
+    bar[i] = (i < pos) ? '=' : (i == pos) ? '>' : ' ';
+  }
+  bar[barWidth] = '\0';
+
+  // remaining time extrapolated from the rate so far
+  float eta = fraction > 0.f ? elapsed * (1.f - fraction) / fraction : 0.f;
+
+  // a single write per line, no stream state shared with the rest of the program
+  std::printf("[%s] %6.2f%% %s %5.0fs %7.2f Mrays/s %7.2f Msamples/s%c", bar, 100.f * fraction,
+              final ? "total" : "ETA  ", final ? elapsed : eta, getRays() / elapsed * 1e-6f,
+              getSamples() / elapsed * 1e-6f, final ? '\n' : '\r');
+  std::fflush(stdout);
+}
+
+}  // namespace spt
@@ -0,0 +1,161 @@
+#include "SceneFile.hpp"
+#include "BVH.hpp"
+#include "Material.hpp"
+#include "Triangle.hpp"
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace spt {
+
+static const char SCENE_MAGIC[4] = {'S', 'P', 'T', 'C'};
+static const uint32_t SCENE_VERSION = 1;
+static const uint64_t SCENE_ALIGN = 64;
+
+SceneFile::SceneFile() : fd(-1), data(nullptr), size(0) {}
+
+SceneFile::~SceneFile() {
+  if (data != nullptr) {
+    ::munmap(const_cast<char*>(data), size);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+bool SceneFile::open(const std::string& fileName) {
+  fd = ::open(fileName.c_str(), O_RDONLY);
+  struct stat st;
+  if (fd < 0 || ::fstat(fd, &st) != 0 || size_t(st.st_size) < sizeof(SceneHeader)) {
+    return false;
+  }
+  size = size_t(st.st_size);
+
+  void* mapped = ::mmap(nullptr, size, PROT_READ, MAP_PRIVATE, fd, 0);
+  if (mapped == MAP_FAILED) {
+    size = 0;
+    return false;
+  }
+  data = static_cast<const char*>(mapped);
+  std::memcpy(&header, data, sizeof(header));
+  return validate();
+}
+
+// a corrupt or foreign file must not send the loader out of bounds
+bool SceneFile::validate() const {
+  if (std::memcmp(header.magic, SCENE_MAGIC, 4) != 0 || header.version != SCENE_VERSION ||
+      header.materialSize != sizeof(Material) || header.triangleSize != sizeof(TriangleRecord) ||
+      header.nodeSize != sizeof(BVHNodeRecord)) {
+    return false;
+  }
+
+  auto fits = [this](const SceneSection& section, size_t recordSize) {
+    return section.offset % SCENE_ALIGN == 0 && section.offset <= size &&
+           section.count <= (size - section.offset) / recordSize;
+  };
+  auto strings = [this, &fits](const SceneSection& section) {
+    return fits(section, 1) && (section.count == 0 || data[section.offset + section.count - 1] == '\0');
+  };
+  if (!fits(header.materials, sizeof(Material)) || !fits(header.triangles, sizeof(TriangleRecord)) ||
+      !fits(header.nodes, sizeof(BVHNodeRecord)) || !fits(header.objectIds, sizeof(uint32_t)) ||
+      !fits(header.lights, sizeof(uint32_t)) || !strings(header.config) || !strings(header.dir) ||
+      !strings(header.materialNames) || !strings(header.textureNames) || header.nodes.count == 0) {
+    return false;
+  }
+  if (getStrings(header.materialNames).size() != header.materials.count ||
+      getStrings(header.textureNames).size() != header.materials.count) {
+    return false;
+  }
+
+  // children come after their parent, so restoring always terminates
+  const BVHNodeRecord* nodes = get<BVHNodeRecord>(header.nodes);
+  for (uint64_t i = 0; i < header.nodes.count; i++) {
+    const BVHNodeRecord& node = nodes[i];
+    bool ok = node.isLeaf ? node.begin <= node.end && node.end <= header.objectIds.count
+                          : node.begin > i && node.end > i && node.begin < header.nodes.count && node.end < header.nodes.count;
+    if (!ok) {
+      return false;
+    }
+  }
+
+  const uint32_t* objectIds = get<uint32_t>(header.objectIds);
+  for (uint64_t i = 0; i < header.objectIds.count; i++) {
+    if (objectIds[i] >= header.triangles.count) {
+      return false;
+    }
+  }
+  const uint32_t* lights = get<uint32_t>(header.lights);
+  for (uint64_t i = 0; i < header.lights.count; i++) {
+    if (lights[i] >= header.triangles.count) {
+      return false;
+    }
+  }
+  const TriangleRecord* triangles = get<TriangleRecord>(header.triangles);
+  for (uint64_t i = 0; i < header.triangles.count; i++) {
+    if (triangles[i].mtlId >= header.materials.count) {
+      return false;
+    }
+  }
+  return true;
+}
+
+std::vector<std::string> SceneFile::getStrings(const SceneSection& section) const {
+  std::vector<std::string> strings;
+  const char* p = data + section.offset;
+  const char* end = p + section.count;
+  while (p < end) {
+    strings.emplace_back(p);
+    p += strings.back().size() + 1;
+  }
+  return strings;
+}
+
+bool SceneWriter::open(const std::string& name) {
+  fileName = name;
+  tmpName = name + ".tmp";
+  out.open(tmpName, std::ios::binary | std::ios::trunc);
+  std::memset(&header, 0, sizeof(header));
+  std::memcpy(header.magic, SCENE_MAGIC, 4);
+  header.version = SCENE_VERSION;
+  header.materialSize = sizeof(Material);
+  header.triangleSize = sizeof(TriangleRecord);
+  header.nodeSize = sizeof(BVHNodeRecord);
+
+  // room for the header, written last
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  return out.good();
+}
+
+void SceneWriter::align() {
+  static const char zeros[SCENE_ALIGN] = {};
+  uint64_t pos = uint64_t(out.tellp());
+  out.write(zeros, (SCENE_ALIGN - pos % SCENE_ALIGN) % SCENE_ALIGN);
+}
+
+void SceneWriter::addStrings(SceneSection& section, const std::vector<std::string>& strings) {
+  std::vector<char> bytes;
+  for (const std::string& s : strings) {
+    bytes.insert(bytes.end(), s.begin(), s.end());
+    bytes.push_back('\0');
+  }
+  add(section, bytes);
+}
+
+bool SceneWriter::close() {
+  out.seekp(0);
+  out.write(reinterpret_cast<const char*>(&header), sizeof(header));
+  out.close();
+  if (!out.good()) {
+    std::remove(tmpName.c_str());
+    return false;
+  }
+
+  // an interrupted compile never leaves a truncated scene behind
+  return std::rename(tmpName.c_str(), fileName.c_str()) == 0;
+}
+
+}  // namespace spt
@@ -0,0 +1,502 @@
+#include "Server.hpp"
+#include "ThreadPool.hpp"
+#include "Trace.hpp"
+
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <thread>
+#include <unistd.h>
+
+namespace spt {
+
+// just enough JSON for jobs: objects, arrays, strings, numbers, booleans and null
+struct Json {
+  enum Type { JSON_NULL, JSON_BOOL, JSON_NUMBER, JSON_STRING, JSON_ARRAY, JSON_OBJECT };
+
+  Type type = JSON_NULL;
+  bool boolean = false;
+  double number = 0.0;
+  std::string string;
+  std::vector<Json> items;
+  std::map<std::string, Json> members;
+
+  const Json* get(const std::string& key) const {
+    auto it = members.find(key);
+    return it == members.end() ? nullptr : &it->second;
+  }
+};
+
+class JsonParser {
+ private:
+  const std::string& text;
+  size_t pos;
+
+  void skipSpace() {
+    while (pos < text.size() && (text[pos] == ' ' || text[pos] == '\t' || text[pos] == '\r' || text[pos] == '\n')) {
+      pos++;
+    }
+  }
+
+  bool consume(const char* word) {
+    size_t n = strlen(word);
+    if (text.compare(pos, n, word) != 0) {
+      return false;
+    }
+    pos += n;
+    return true;
+  }
+
+  bool parseString(std::string& out) {
+    if (pos >= text.size() || text[pos] != '"') {
+      return false;
+    }
+    pos++;
+    while (pos < text.size() && text[pos] != '"') {
+      char c = text[pos++];
+      if (c != '\\') {
+        out.push_back(c);
+        continue;
+      }
+      if (pos >= text.size()) {
+        return false;
+      }
+      c = text[pos++];
+      switch (c) {
+        case 'b': out.push_back('\b'); break;
+        case 'f': out.push_back('\f'); break;
+        case 'n': out.push_back('\n'); break;
+        case 'r': out.push_back('\r'); break;
+        case 't': out.push_back('\t'); break;
+        case 'u': {
+          // basic multilingual plane only, as utf-8
+          unsigned code = 0;
+          if (pos + 4 > text.size() || std::sscanf(text.c_str() + pos, "%4x", &code) != 1) {
+            return false;
+          }
+          pos += 4;
+          if (code < 0x80) {
+            out.push_back(char(code));
+          } else if (code < 0x800) {
+            out.push_back(char(0xC0 | (code >> 6)));
+            out.push_back(char(0x80 | (code & 0x3F)));
+          } else {
+            out.push_back(char(0xE0 | (code >> 12)));
+            out.push_back(char(0x80 | ((code >> 6) & 0x3F)));
+            out.push_back(char(0x80 | (code & 0x3F)));
+          }
+          break;
+        }
+        default: out.push_back(c); break;
+      }
+    }
+    if (pos >= text.size()) {
+      return false;
+    }
+    pos++;
+    return true;
+  }
+
+  bool parseValue(Json& value, int depth) {
+    skipSpace();
+    if (pos >= text.size() || depth > 32) {
+      return false;
+    }
+    char c = text[pos];
+    if (c == '{') {
+      value.type = Json::JSON_OBJECT;
+      pos++;
+      skipSpace();
+      if (pos < text.size() && text[pos] == '}') {
+        pos++;
+        return true;
+      }
+      while (true) {
+        std::string key;
+        skipSpace();
+        if (!parseString(key)) {
+          return false;
+        }
+        skipSpace();
+        if (pos >= text.size() || text[pos++] != ':' || !parseValue(value.members[key], depth + 1)) {
+          return false;
+        }
+        skipSpace();
+        if (pos < text.size() && text[pos] == ',') {
+          pos++;
+        } else {
+          return pos < text.size() && text[pos++] == '}';
+        }
+      }
+    }
+    if (c == '[') {
+      value.type = Json::JSON_ARRAY;
+      pos++;
+      skipSpace();
+      if (pos < text.size() && text[pos] == ']') {
+        pos++;
+        return true;
+      }
+      while (true) {
+        value.items.emplace_back();
+        if (!parseValue(value.items.back(), depth + 1)) {
+          return false;
+        }
+        skipSpace();
+        if (pos < text.size() && text[pos] == ',') {
+          pos++;
+        } else {
+          return pos < text.size() && text[pos++] == ']';
+        }
+      }
+    }
+    if (c == '"') {
+      value.type = Json::JSON_STRING;
+      return parseString(value.string);
+    }
+    if (consume("true")) {
+      value.type = Json::JSON_BOOL;
+      value.boolean = true;
+      return true;
+    }
+    if (consume("false")) {
+      value.type = Json::JSON_BOOL;
+      return true;
+    }
+    if (consume("null")) {
+      return true;
+    }
+    char* end = nullptr;
+    value.type = Json::JSON_NUMBER;
+    value.number = std::strtod(text.c_str() + pos, &end);
+    if (end == text.c_str() + pos) {
+      return false;
+    }
+    pos = end - text.c_str();
+    return true;
+  }
+
+ public:
+  explicit JsonParser(const std::string& _text) : text(_text), pos(0) {}
+
+  // the whole text must be one value
+  bool parse(Json& value) {
+    if (!parseValue(value, 0)) {
+      return false;
+    }
+    skipSpace();
+    return pos == text.size();
+  }
+};
+
+static std::string quote(const std::string& s) {
+  std::string out = "\"";
+  for (char c : s) {
+    if (c == '"' || c == '\\') {
+      out.push_back('\\');
+      out.push_back(c);
+    } else if (c == '\n') {
+      out += "\\n";
+    } else if (uint8_t(c) < 0x20) {
+      char code[8];
+      std::snprintf(code, sizeof(code), "\\u%04x", c);
+      out += code;
+    } else {
+      out.push_back(c);
+    }
+  }
+  return out + "\"";
+}
+
+static std::string errorReply(const std::string& message) {
+  return "{\"ok\":false,\"error\":" + quote(message) + "}";
+}
+
+// x, y, z of a 3 element array
+static bool getVec3(const Json* value, Vec3<float>& v) {
+  if (value == nullptr || value->type != Json::JSON_ARRAY || value->items.size() != 3) {
+    return false;
+  }
+  for (const Json& item : value->items) {
+    if (item.type != Json::JSON_NUMBER || !std::isfinite(item.number)) {
+      return false;
+    }
+  }
+  v = Vec3<float>(float(value->items[0].number), float(value->items[1].number), float(value->items[2].number));
+  return true;
+}
+
+// a positive whole number that fits the counts of the tracer, n stays zero if value is absent
+static bool getCount(const Json* value, size_t& n) {
+  if (value == nullptr) {
+    return true;
+  }
+  // inf and nan fail the range check too
+  if (value->type != Json::JSON_NUMBER || !(value->number >= 1 && value->number <= double(UINT32_MAX)) ||
+      value->number != std::floor(value->number)) {
+    return false;
+  }
+  n = size_t(value->number);
+  return true;
+}
+
+RenderServer::RenderServer(size_t threads, size_t _depth, size_t _samples, float _p)
+    : pool(std::make_shared<ThreadPool>(threads)), depth(_depth), samples(_samples), maxProb(_p), listenFd(-1),
+      stopping(false) {}
+
+RenderServer::~RenderServer() = default;
+
+bool RenderServer::handle(const std::string& line, std::string& reply) {
+  Json job;
+  if (!JsonParser(line).parse(job) || job.type != Json::JSON_OBJECT) {
+    reply = errorReply("malformed job");
+    return true;
+  }
+  const Json* command = job.get("command");
+  std::string name = (command != nullptr && command->type == Json::JSON_STRING) ? command->string : "render";
+  if (name == "quit") {
+    reply = "{\"ok\":true}";
+    return false;
+  }
+
+  // scene files, the cache key
+  const Json* dirValue = job.get("scene");
+  const Json* modelsValue = job.get("models");
+  const Json* configValue = job.get("config");
+  if (dirValue == nullptr || dirValue->type != Json::JSON_STRING || configValue == nullptr ||
+      configValue->type != Json::JSON_STRING || modelsValue == nullptr || modelsValue->type != Json::JSON_ARRAY) {
+    reply = errorReply("job needs scene, models and config");
+    return true;
+  }
+  std::string dir = dirValue->string;
+  std::vector<std::string> models;
+  std::string key = dir + '\n' + configValue->string;
+  for (const Json& model : modelsValue->items) {
+    if (model.type != Json::JSON_STRING) {
+      reply = errorReply("models must be file names");
+      return true;
+    }
+    models.push_back(model.string);
+    key += '\n' + model.string;
+  }
+
+  std::lock_guard<std::mutex> lock(jobMutex);
+  if (name == "unload") {
+    bool found = scenes.erase(key) > 0;
+    reply = found ? "{\"ok\":true}" : errorReply("scene not loaded");
+    return true;
+  }
+  if (name != "render") {
+    reply = errorReply("unknown command " + name);
+    return true;
+  }
+
+  // counts must be whole numbers a size_t holds; checked before anything is loaded
+  size_t spp = 0, maxDepth = 0;
+  if (!getCount(job.get("spp"), spp) || !getCount(job.get("depth"), maxDepth)) {
+    reply = errorReply("spp and depth must be positive integers");
+    return true;
+  }
+
+  // load on first use
+  auto start = std::chrono::steady_clock::now();
+  auto it = scenes.find(key);
+  bool cached = it != scenes.end();
+  if (!cached) {
+    auto tracer = std::make_unique<Tracer>(depth, samples, maxProb);
+    // render logs go to stderr, stdout may carry the replies; loading runs on the
+    // shared workers too
+    tracer->setLog(std::cerr);
+    tracer->setPool(pool);
+    tracer->setQuiet(true);
+    if (!tracer->load(dir, models, configValue->string)) {
+      reply = errorReply("scene load failure");
+      return true;
+    }
+    it = scenes.emplace(key, std::move(tracer)).first;
+  }
+  Tracer& tracer = *it->second;
+  double loadSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  // overrides only hold for this job
+  Camera camera = tracer.getCamera();
+  size_t sceneSamples = tracer.getSamples(), sceneDepth = tracer.getDepth();
+  if (spp > 0) {
+    tracer.setSamples(spp);
+  }
+  if (maxDepth > 0) {
+    tracer.setDepth(maxDepth);
+  }
+  const Json* value;
+  const Json* cameraValue = job.get("camera");
+  if (cameraValue != nullptr && cameraValue->type == Json::JSON_OBJECT) {
+    Camera& c = tracer.getCamera();
+    Vec3<float> v;
+    value = cameraValue->get("fovy");
+    if (value != nullptr && value->type == Json::JSON_NUMBER && value->number > 0 && value->number < 180) {
+      c.setFovy(value->number);
+    }
+    if (getVec3(cameraValue->get("up"), v)) {
+      c.setUp(v.x, v.y, v.z);
+    }
+    if (getVec3(cameraValue->get("lookat"), v)) {
+      c.setLookAt(v.x, v.y, v.z);
+    }
+    if (getVec3(cameraValue->get("eye"), v)) {
+      c.setEye(v.x, v.y, v.z);
+    }
+  }
+  value = job.get("output");
+  std::string output = (value != nullptr && value->type == Json::JSON_STRING) ? value->string : "result.png";
+
+  start = std::chrono::steady_clock::now();
+  bool written = tracer.render(output);
+  double renderSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+  tracer.getCamera() = camera;
+  tracer.setSamples(sceneSamples);
+  tracer.setDepth(sceneDepth);
+
+  if (!written) {
+    reply = errorReply("image write failure");
+    return true;
+  }
+  std::ostringstream out;
+  out << "{\"ok\":true,\"output\":" << quote(output) << ",\"cached\":" << (cached ? "true" : "false")
+      << ",\"load\":" << loadSeconds << ",\"render\":" << renderSeconds << '}';
+  reply = out.str();
+  return true;
+}
+
+void RenderServer::serveStdin() {
+  std::string line;
+  while (std::getline(std::cin, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    std::string reply;
+    bool running = handle(line, reply);
+    std::cout << reply << std::endl;
+    if (!running) {
+      break;
+    }
+  }
+}
+
+void RenderServer::serveConnection(int fd) {
+  std::string buffer;
+  char chunk[4096];
+  bool running = true;
+  while (running) {
+    ssize_t n = ::read(fd, chunk, sizeof(chunk));
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      break;
+    }
+    buffer.append(chunk, n);
+
+    // every complete line is a job
+    size_t end;
+    while (running && (end = buffer.find('\n')) != std::string::npos) {
+      std::string line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      if (line.find_first_not_of(" \t\r") == std::string::npos) {
+        continue;
+      }
+      std::string reply;
+      running = handle(line, reply);
+      reply.push_back('\n');
+      for (size_t sent = 0; sent < reply.size();) {
+        ssize_t m = ::send(fd, reply.data() + sent, reply.size() - sent, MSG_NOSIGNAL);
+        if (m < 0 && errno == EINTR) {
+          continue;
+        }
+        if (m <= 0) {
+          break;
+        }
+        sent += m;
+      }
+    }
+  }
+  if (!running) {
+    stop();
+  }
+
+  std::lock_guard<std::mutex> lock(connectionMutex);
+  connections.erase(fd);
+  ::close(fd);
+  drained.notify_all();
+}
+
+// wakes the accept loop and every connection blocked in read; clients keep their
+// write side, so the reply of a job in flight still reaches them
+void RenderServer::stop() {
+  stopping = true;
+  std::lock_guard<std::mutex> lock(connectionMutex);
+  ::shutdown(listenFd, SHUT_RDWR);
+  for (int fd : connections) {
+    ::shutdown(fd, SHUT_RD);
+  }
+}
+
+bool RenderServer::serveSocket(const std::string& path) {
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: Socket path too long (file: " << path << ")" << std::endl;
+    return false;
+  }
+  strcpy(address.sun_path, path.c_str());
+
+  // a stale socket of an earlier server is replaced
+  listenFd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  ::unlink(path.c_str());
+  if (listenFd < 0 || ::bind(listenFd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0 ||
+      ::listen(listenFd, 16) != 0) {
+    std::cerr << "Error: Socket listen failure (file: " << path << ")" << std::endl;
+    if (listenFd >= 0) {
+      ::close(listenFd);
+      listenFd = -1;
+    }
+    return false;
+  }
+  std::cerr << "Serving on " << path << std::endl;
+
+  while (!stopping) {
+    int fd = ::accept(listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EINTR && !stopping) {
+        continue;
+      }
+      break;
+    }
+    std::lock_guard<std::mutex> lock(connectionMutex);
+    if (stopping) {
+      ::close(fd);
+      break;
+    }
+    connections.insert(fd);
+    std::thread(&RenderServer::serveConnection, this, fd).detach();
+  }
+
+  // jobs in flight finish and are answered before the server returns
+  stop();
+  std::unique_lock<std::mutex> lock(connectionMutex);
+  drained.wait(lock, [this] { return connections.empty(); });
+  lock.unlock();
+  ::close(listenFd);
+  listenFd = -1;
+  ::unlink(path.c_str());
+  return true;
+}
+
+}  // namespace spt
@@ -1,42 +1,409 @@
 #include "Texture.hpp"
+#include "TextureCache.hpp"
+#include "ThreadPool.hpp"
 
 #define STB_IMAGE_IMPLEMENTATION 
 #include <stb_image.h>
+#include <algorithm>
+#include <atomic>
 #include <cassert>
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
 #include <iostream>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
 
 namespace spt {
 std::unordered_map<std::string, Texture*> Texture::textures;
+std::mutex Texture::texturesMutex;
+
+// header of the tiled file, followed by (width, height) of each level and the tiles
+struct TiledHeader {
+  char magic[4];
+  uint32_t version;
+  int32_t width, height, channels;
+  int32_t levels;
+  int32_t tileSize;
+};
+
+static const char TILED_MAGIC[4] = {'S', 'P', 'T', 'X'};
+static const uint32_t TILED_VERSION = 1;
+
+// tiled file is usable if it is not older than its source image
+static bool isFresh(const std::string& tiledName, const std::string& texName) {
+  struct stat tiled, source;
+  if (::stat(tiledName.c_str(), &tiled) != 0) {
+    return false;
+  }
+  return ::stat(texName.c_str(), &source) != 0 || tiled.st_mtime >= source.st_mtime;
+}
+
+// 8-bit sRGB to linear
+static const float* srgbLut() {
+  static const std::vector<float> lut = [] {
+    std::vector<float> table(256);
+    for (int i = 0; i < 256; i++) {
+      float c = i / 255.0f;
+      table[i] = c <= 0.04045f ? c / 12.92f : ::powf((c + 0.055f) / 1.055f, 2.4f);
+    }
+    return table;
+  }();
+  return lut.data();
+}
+
+// linear to 8-bit sRGB, only used while building mipmaps
+static uint8_t encodeSrgb(float c) {
+  c = c <= 0.0031308f ? c * 12.92f : 1.055f * ::powf(c, 1 / 2.4f) - 0.055f;
+  return std::min(255.f, std::max(0.f, c * 255.f + 0.5f));
+}
 
 Texture::~Texture() {
-  if (img) {
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+void Texture::load(const std::string& texName) {
+  static std::atomic<uint> nextId(0);
+  id = nextId++;
+
+  // page in tiles on demand if a converted file already exists
+  bool tiled = TextureCache::getInstance().isEnabled();
+  std::string tiledName = texName + ".tiles";
+  if (tiled && isFresh(tiledName, texName) && openTiled(tiledName)) {
+    return;
+  }
+
+  // hdr images are linear already, kept as float and in memory
+  if (stbi_is_hdr(texName.c_str())) {
+    float* img = stbi_loadf(texName.c_str(), &width, &height, &channels, 3);
+    if (img == nullptr) {
+      std::cerr << "Error: Texture load failure (file: " << texName << ")" << std::endl;
+      width = height = channels = 0;
+      return;
+    }
+
+    storage = TEXTURE_LINEAR;
+    channels = 3;
+    MipLevel level{width, height, 0, 0, 0, {}, std::vector<Vec3<float>>(width * height)};
+    for (int i = 0; i < width * height; i++) {
+      level.linear[i] = Vec3<float>(img[i * 3 + 0], img[i * 3 + 1], img[i * 3 + 2]);
+    }
     stbi_image_free(img);
+
+    levels.push_back(std::move(level));
+    buildMipmaps();
+    return;
+  }
+
+  // native channel count, grey and alpha images stay small
+  uint8_t* img = stbi_load(texName.c_str(), &width, &height, &channels, 0);
+  if (img == nullptr) {
+    std::cerr << "Error: Texture load failure (file: " << texName << ")" << std::endl;
+    width = height = channels = 0;
+    return;
+  }
+
+  storage = TEXTURE_SRGB8;
+  levels.push_back({width, height, 0, 0, 0, std::vector<uint8_t>(img, img + width * height * channels), {}});
+  stbi_image_free(img);
+
+  buildMipmaps();
+
+  // convert once, then drop the decoded pyramid, stay in memory if the file cannot be written
+  if (tiled && writeTiled(tiledName) && openTiled(tiledName)) {
+    for (auto& level : levels) {
+      std::vector<uint8_t>().swap(level.texels);
+    }
+    return;
+  }
+
+  // small textures are linearised once, large ones keep 8-bit and decode per lookup
+  if (width * height <= LINEAR_MAX_TEXELS) {
+    for (auto& level : levels) {
+      level.linear.resize(level.width * level.height);
+      for (int i = 0; i < level.width * level.height; i++) {
+        level.linear[i] = decode(&level.texels[i * channels]);
+      }
+      std::vector<uint8_t>().swap(level.texels);
+    }
+    storage = TEXTURE_LINEAR;
   }
-  img = nullptr;
 }
 
-Texture::Texture(const std::string& texName) {
-  img = stbi_load(texName.c_str(), &width, &height, &channels, 0);
+// write all of n bytes, retrying short writes
+static bool writeAll(int file, const void* data, size_t n) {
+  const char* p = static_cast<const char*>(data);
+  while (n > 0) {
+    ssize_t written = ::write(file, p, n);
+    if (written < 0 && errno == EINTR) {
+      continue;
+    }
+    if (written <= 0) {
+      return false;
+    }
+    p += written;
+    n -= written;
+  }
+  return true;
+}
+
+bool Texture::writeTiled(const std::string& tiledName) const {
+  // a unique temporary renamed into place, so a crash or a concurrent conversion
+  // of the same texture never leaves a partial file under the final name
+  std::string tmpName = tiledName + ".XXXXXX";
+  int file = ::mkstemp(&tmpName[0]);
+  if (file < 0) {
+    return false;
+  }
+  bool ok = ::fchmod(file, 0644) == 0;
+
+  TiledHeader header;
+  std::memcpy(header.magic, TILED_MAGIC, 4);
+  header.version = TILED_VERSION;
+  header.width = width;
+  header.height = height;
+  header.channels = channels;
+  header.levels = levels.size();
+  header.tileSize = TILE_SIZE;
+  ok = ok && writeAll(file, &header, sizeof(header));
+  for (const auto& level : levels) {
+    int32_t size[2] = {level.width, level.height};
+    ok = ok && writeAll(file, size, sizeof(size));
+  }
+
+  // tiles row by row, edge tiles padded with black
+  std::vector<uint8_t> tile(tileBytes());
+  for (const auto& level : levels) {
+    for (int ty = 0; ok && ty * TILE_SIZE < level.height; ty++) {
+      for (int tx = 0; ok && tx * TILE_SIZE < level.width; tx++) {
+        std::fill(tile.begin(), tile.end(), 0);
+        for (int r = 0; r < TILE_SIZE && ty * TILE_SIZE + r < level.height; r++) {
+          int row = ty * TILE_SIZE + r, col = tx * TILE_SIZE;
+          int cols = std::min(TILE_SIZE, level.width - col);
+          std::memcpy(&tile[r * TILE_SIZE * channels], &level.texels[(row * level.width + col) * channels], cols * channels);
+        }
+        ok = writeAll(file, tile.data(), tile.size());
+      }
+    }
+  }
+
+  ok = ::fsync(file) == 0 && ok;
+  ok = ::close(file) == 0 && ok;
+  if (!ok || std::rename(tmpName.c_str(), tiledName.c_str()) != 0) {
+    ::unlink(tmpName.c_str());
+    return false;
+  }
+  return true;
+}
+
+bool Texture::openTiled(const std::string& tiledName) {
+  int file = ::open(tiledName.c_str(), O_RDONLY);
+  if (file < 0) {
+    return false;
+  }
+
+  // header and level sizes
+  TiledHeader header;
+  bool valid = ::pread(file, &header, sizeof(header), 0) == sizeof(header) && std::memcmp(header.magic, TILED_MAGIC, 4) == 0 &&
+               header.version == TILED_VERSION && header.tileSize == TILE_SIZE && header.levels > 0 &&
+               header.channels >= 1 && header.channels <= 4;
+  std::vector<int32_t> sizes(valid ? header.levels * 2 : 0);
+  valid = valid && ::pread(file, sizes.data(), sizes.size() * sizeof(int32_t), sizeof(header)) == ssize_t(sizes.size() * sizeof(int32_t));
+  if (!valid) {
+    ::close(file);
+    return false;
+  }
+
+  width = header.width;
+  height = header.height;
+  channels = header.channels;
+  storage = TEXTURE_SRGB8;
+  levels.clear();
+  int64_t offset = sizeof(header) + sizes.size() * sizeof(int32_t);
+  for (int i = 0; i < header.levels && valid; i++) {
+    MipLevel level;
+    level.width = sizes[i * 2];
+    level.height = sizes[i * 2 + 1];
+    valid = level.width > 0 && level.height > 0;
+    level.tilesX = (level.width + TILE_SIZE - 1) / TILE_SIZE;
+    level.tilesY = (level.height + TILE_SIZE - 1) / TILE_SIZE;
+    level.offset = offset;
+    offset += int64_t(level.tilesX) * level.tilesY * tileBytes();
+    levels.push_back(std::move(level));
+  }
+
+  // a truncated file would page in short tiles, rejected here so it is converted again
+  struct stat st;
+  if (!valid || ::fstat(file, &st) != 0 || st.st_size != offset) {
+    ::close(file);
+    levels.clear();
+    width = height = channels = 0;
+    return false;
+  }
+
+  fd = file;
+  return true;
+}
+
+// box filtered pyramid down to 1x1, odd sizes clamp the last row/column
+void Texture::buildMipmaps() {
+  const float* lut = srgbLut();
+  while (levels.back().width > 1 || levels.back().height > 1) {
+    const MipLevel& src = levels.back();
+    MipLevel dst{std::max(1, src.width / 2), std::max(1, src.height / 2), 0, 0, 0, {}, {}};
+    if (storage == TEXTURE_LINEAR) {
+      dst.linear.resize(dst.width * dst.height);
+    } else {
+      dst.texels.resize(dst.width * dst.height * channels);
+    }
+
+    for (int row = 0; row < dst.height; row++) {
+      int r0 = std::min(2 * row, src.height - 1), r1 = std::min(2 * row + 1, src.height - 1);
+      for (int col = 0; col < dst.width; col++) {
+        int c0 = std::min(2 * col, src.width - 1), c1 = std::min(2 * col + 1, src.width - 1);
+        int i00 = r0 * src.width + c0, i01 = r0 * src.width + c1, i10 = r1 * src.width + c0, i11 = r1 * src.width + c1;
+        int idx = row * dst.width + col;
+
+        if (storage == TEXTURE_LINEAR) {
+          dst.linear[idx] = (src.linear[i00] + src.linear[i01] + src.linear[i10] + src.linear[i11]) * 0.25f;
+          continue;
+        }
+
+        // average colors in linear space, alpha as is
+        for (int c = 0; c < channels; c++) {
+          const uint8_t* t = src.texels.data();
+          bool color = channels <= 2 ? c == 0 : c < 3;
+          if (color) {
+            float sum = lut[t[i00 * channels + c]] + lut[t[i01 * channels + c]] + lut[t[i10 * channels + c]] + lut[t[i11 * channels + c]];
+            dst.texels[idx * channels + c] = encodeSrgb(sum * 0.25f);
+          } else {
+            int sum = t[i00 * channels + c] + t[i01 * channels + c] + t[i10 * channels + c] + t[i11 * channels + c];
+            dst.texels[idx * channels + c] = (sum + 2) / 4;
+          }
+        }
+      }
+    }
+    levels.push_back(std::move(dst));
+  }
 }
 
 Texture* Texture::getInstance(const std::string& texName) {
-  if (textures.find(texName) == textures.end()) {
-    textures[texName] = new Texture(texName);
+  Texture* texture;
+  {
+    std::lock_guard<std::mutex> lock(texturesMutex);
+    auto& slot = textures[texName];
+    if (slot == nullptr) {
+      slot = new Texture();
+    }
+    texture = slot;
+  }
+
+  // decode outside the lock, other requests of the same texture wait here
+  std::call_once(texture->loaded, &Texture::load, texture, texName);
+  return texture;
+}
+
+void Texture::preload(const std::vector<std::string>& texNames, ThreadPool& pool, const std::shared_ptr<TaskGroup>& group,
+                      const DecodeTimer& onDecoded) {
+  // one task per texture, repeats would only block workers in call_once
+  std::vector<std::string> names;
+  std::copy_if(texNames.begin(), texNames.end(), std::back_inserter(names), [](const std::string& n) { return !n.empty(); });
+  std::sort(names.begin(), names.end());
+  names.erase(std::unique(names.begin(), names.end()), names.end());
+
+  std::vector<std::function<void()>> decodes;
+  for (std::string& texName : names) {
+    decodes.push_back([texName = std::move(texName), onDecoded] {
+      auto begin = std::chrono::steady_clock::now();
+      getInstance(texName);
+      if (onDecoded) {
+        onDecoded(begin, std::chrono::steady_clock::now());
+      }
+    });
+  }
+  pool.submit(std::move(decodes), group);
+}
+
+size_t Texture::getCount() {
+  std::lock_guard<std::mutex> lock(texturesMutex);
+  return textures.size();
+}
+
+Vec3<float> Texture::decode(const uint8_t* t) const {
+  const float* lut = srgbLut();
+  if (channels <= 2) {
+    return Vec3<float>(lut[t[0]], lut[t[0]], lut[t[0]]);
   }
-  return textures[texName];
+  return Vec3<float>(lut[t[0]], lut[t[1]], lut[t[2]]);
 }
 
-Vec3<float> Texture::getColorAt(const Vec2<float>& pos) {
+Vec3<float> Texture::texel(int l, int row, int col) const {
+  const MipLevel& level = levels[l];
+  if (storage == TEXTURE_LINEAR) {
+    return level.linear[row * level.width + col];
+  }
+  if (fd < 0) {
+    return decode(&level.texels[(row * level.width + col) * channels]);
+  }
+
+  // the last tile of each thread is kept, neighbouring lookups rarely leave it
+  thread_local uint64_t lastKey = ~0ull;
+  thread_local std::shared_ptr<const TextureTile> lastTile;
+
+  int tx = col / TILE_SIZE, ty = row / TILE_SIZE;
+  uint64_t key = (uint64_t(id) << 40) | (uint64_t(l) << 32) | (uint64_t(ty) << 16) | uint64_t(tx);
+  if (key != lastKey) {
+    int64_t offset = level.offset + (int64_t(ty) * level.tilesX + tx) * tileBytes();
+    lastTile = TextureCache::getInstance().getTile(key, fd, offset, tileBytes());
+    lastKey = key;
+  }
+
+  return decode(&(*lastTile)[((row % TILE_SIZE) * TILE_SIZE + col % TILE_SIZE) * channels]);
+}
+
+Vec3<float> Texture::bilinear(int l, const Vec2<float>& pos) const {
+  const MipLevel& level = levels[l];
+  // u indexes rows, v indexes columns, texel centers at half integers
+  float y = pos.u * level.height - 0.5f, x = pos.v * level.width - 0.5f;
+  float fy = ::floorf(y), fx = ::floorf(x);
+  float dy = y - fy, dx = x - fx;
+
+  // wrap around, matching the repeat of texture coordinates
+  auto wrap = [](int i, int n) { return ((i % n) + n) % n; };
+  int r0 = wrap(fy, level.height), r1 = wrap(fy + 1, level.height);
+  int c0 = wrap(fx, level.width), c1 = wrap(fx + 1, level.width);
+
+  return (texel(l, r0, c0) * (1 - dx) + texel(l, r0, c1) * dx) * (1 - dy) +
+         (texel(l, r1, c0) * (1 - dx) + texel(l, r1, c1) * dx) * dy;
+}
+
+Vec3<float> Texture::getColorAt(const Vec2<float>& pos, float footprint) {
   assert(pos.u >= 0 && pos.u <= 1 && pos.v >= 0 && pos.v <= 1);
+  if (levels.empty()) {
+    return Vec3<float>(0, 0, 0);
+  }
+
+  // level where one texel covers the footprint
+  float lod = 0.f;
+  if (footprint > 0.f) {
+    lod = ::log2f(footprint * ::sqrtf(float(width) * height));
+    lod = std::min(std::max(lod, 0.f), float(levels.size() - 1));
+  }
 
-  Vec3<float> color(0, 0, 0);
-  int row = pos.u*height, col = pos.v*width;
-  int idx = (row*width+col)*3;
-  color.x = img[idx+0]/255.0f;
-  color.y = img[idx+1]/255.0f;
-  color.z = img[idx+2]/255.0f;
+  int l0 = lod;
+  int l1 = std::min(l0 + 1, int(levels.size() - 1));
+  float t = lod - l0;
 
+  Vec3<float> color = bilinear(l0, pos);
+  if (t > 0.f) {
+    color = color * (1 - t) + bilinear(l1, pos) * t;
+  }
   return color;
 }
 
-}  // namespace spt
\ No newline at end of file
+}  // namespace spt
@@ -0,0 +1,88 @@
+#include "TextureCache.hpp"
+
+#include <chrono>
+#include <iostream>
+#include <unistd.h>
+
+namespace spt {
+
+TextureCache& TextureCache::getInstance() {
+  static TextureCache cache;
+  return cache;
+}
+
+void TextureCache::setBudget(size_t bytes) {
+  std::lock_guard<std::mutex> lock(mutex);
+  budget = bytes;
+  evict();
+}
+
+// drop least recently used tiles until within budget, mutex must be held
+void TextureCache::evict() {
+  while (residentBytes > budget && !lru.empty()) {
+    auto itr = tiles.find(lru.back());
+    residentBytes -= itr->second.tile->size();
+    tiles.erase(itr);
+    lru.pop_back();
+    evictions++;
+  }
+}
+
+std::shared_ptr<const TextureTile> TextureCache::getTile(uint64_t key, int fd, int64_t offset, size_t bytes) {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    auto itr = tiles.find(key);
+    if (itr != tiles.end()) {
+      lru.splice(lru.begin(), lru, itr->second.lru);
+      hits++;
+      return itr->second.tile;
+    }
+  }
+  misses++;
+
+  // read without holding the lock, other threads keep shading
+  auto start = std::chrono::steady_clock::now();
+  auto tile = std::make_shared<TextureTile>(bytes);
+  size_t done = 0;
+  while (done < bytes) {
+    ssize_t n = ::pread(fd, tile->data() + done, bytes - done, offset + done);
+    if (n <= 0) {
+      std::cerr << "Error: Texture tile read failure (offset: " << offset << ")" << std::endl;
+      std::fill(tile->begin() + done, tile->end(), 0);
+      break;
+    }
+    done += n;
+  }
+  stallNanos += std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count();
+
+  std::lock_guard<std::mutex> lock(mutex);
+  // another thread may have paged in the same tile meanwhile
+  auto itr = tiles.find(key);
+  if (itr != tiles.end()) {
+    lru.splice(lru.begin(), lru, itr->second.lru);
+    return itr->second.tile;
+  }
+
+  lru.push_front(key);
+  tiles[key] = {tile, lru.begin()};
+  residentBytes += bytes;
+  evict();
+  return tile;
+}
+
+TextureCache::Stats TextureCache::getStats() const {
+  Stats stats;
+  stats.hits = hits;
+  stats.misses = misses;
+  stats.evictions = evictions;
+  stats.stallSeconds = stallNanos * 1e-9;
+  std::lock_guard<std::mutex> lock(mutex);
+  stats.residentBytes = residentBytes;
+  return stats;
+}
+
+void TextureCache::resetStats() {
+  hits = misses = evictions = stallNanos = 0;
+}
+
+}  // namespace spt
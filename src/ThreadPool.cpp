@@ -0,0 +1,196 @@
+#include "ThreadPool.hpp"
+
+#include <algorithm>
+#include <climits>
+
+namespace spt {
+
+ThreadPool::ThreadPool(size_t threadCount)
+    : queued(0), pending(0), next(0), stopping(false), defaultGroup(std::make_shared<TaskGroup>()), top(INT_MIN),
+      topStale(false), seenChanges(TaskGroup::priorityChanges.load()) {
+  if (threadCount == 0) {
+    threadCount = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  for (size_t i = 0; i < threadCount; i++) {
+    workers.push_back(std::make_unique<Worker>());
+  }
+  for (size_t i = 0; i < threadCount; i++) {
+    threads.emplace_back(&ThreadPool::loop, this, i);
+  }
+}
+
+ThreadPool::~ThreadPool() {
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    stopping = true;
+  }
+  wake.notify_all();
+  for (auto& thread : threads) {
+    thread.join();
+  }
+}
+
+void ThreadPool::push(size_t worker, std::function<void()> task, const std::shared_ptr<TaskGroup>& group) {
+  pending++;
+  group->pending++;
+  {
+    // registered before its task is visible, so a worker never misses its priority
+    std::lock_guard<std::mutex> lock(groupMutex);
+    if (group->queued++ == 0) {
+      if (std::find(groups.begin(), groups.end(), group) == groups.end()) {
+        groups.push_back(group);
+      }
+      top = std::max(top.load(), group->getPriority());
+    }
+  }
+  {
+    std::lock_guard<std::mutex> lock(workers[worker]->mutex);
+    auto& queues = workers[worker]->queues;
+    auto it = std::find_if(queues.begin(), queues.end(), [&group](const Queue& q) { return q.group == group; });
+    if (it == queues.end()) {
+      it = queues.insert(queues.end(), Queue{group, {}});
+    }
+    it->tasks.push_back(std::move(task));
+  }
+  queued++;
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+  push(next++ % workers.size(), std::move(task), defaultGroup);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  wake.notify_one();
+}
+
+void ThreadPool::submit(std::vector<std::function<void()>> tasks) {
+  submit(std::move(tasks), defaultGroup);
+}
+
+void ThreadPool::submit(std::vector<std::function<void()>> tasks, const std::shared_ptr<TaskGroup>& group) {
+  size_t n = tasks.size(), w = workers.size();
+  for (size_t i = 0; i < n; i++) {
+    push(i * w / n, std::move(tasks[i]), group);
+  }
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+  }
+  wake.notify_all();
+}
+
+// highest priority of the groups with queued tasks, the cached value unless a group
+// drained or a priority changed since; drained groups are dropped then
+int ThreadPool::topPriority() {
+  unsigned changes = TaskGroup::priorityChanges.load();
+  if (!topStale.load() && changes == seenChanges.load()) {
+    return top;
+  }
+
+  std::lock_guard<std::mutex> lock(groupMutex);
+  // cleared first, a group draining meanwhile marks it again
+  topStale = false;
+  seenChanges = changes;
+  int highest = INT_MIN;
+  groups.erase(std::remove_if(groups.begin(), groups.end(), [](const std::shared_ptr<TaskGroup>& g) { return g->queued == 0; }),
+               groups.end());
+  for (const auto& group : groups) {
+    highest = std::max(highest, group->getPriority());
+  }
+  top = highest;
+  return highest;
+}
+
+// a task of the highest priority group on the worker, if that is at least priority,
+// from the front or the back of its queue
+bool ThreadPool::take(Worker& worker, int priority, bool front, Task& task) {
+  std::lock_guard<std::mutex> lock(worker.mutex);
+  auto& queues = worker.queues;
+  auto best = queues.end();
+  int bestPriority = priority;
+  for (auto it = queues.begin(); it != queues.end(); ++it) {
+    int p = it->group->getPriority();
+    if (p >= bestPriority && (best == queues.end() || p > bestPriority)) {
+      best = it;
+      bestPriority = p;
+    }
+  }
+  if (best == queues.end()) {
+    return false;
+  }
+
+  task.group = best->group;
+  if (front) {
+    task.run = std::move(best->tasks.front());
+    best->tasks.pop_front();
+  } else {
+    task.run = std::move(best->tasks.back());
+    best->tasks.pop_back();
+  }
+  if (best->tasks.empty()) {
+    queues.erase(best);
+  }
+  queued--;
+  if (--task.group->queued == 0) {
+    topStale = true;
+  }
+  return true;
+}
+
+bool ThreadPool::pop(size_t self, Task& task) {
+  // a priority that changed meanwhile falls back to any task
+  int highest = topPriority();
+  for (int priority : {highest, INT_MIN}) {
+    // own work first, oldest task first
+    if (take(*workers[self], priority, true, task)) {
+      return true;
+    }
+
+    // steal the task the victim would reach last
+    for (size_t i = 1; i < workers.size(); i++) {
+      if (take(*workers[(self + i) % workers.size()], priority, false, task)) {
+        return true;
+      }
+    }
+    if (highest == INT_MIN) {
+      break;
+    }
+  }
+  return false;
+}
+
+void ThreadPool::loop(size_t self) {
+  while (true) {
+    Task task;
+    if (pop(self, task)) {
+      task.run();
+      if (--task.group->pending == 0) {
+        std::lock_guard<std::mutex> lock(task.group->mutex);
+        task.group->idle.notify_all();
+      }
+      if (--pending == 0) {
+        std::lock_guard<std::mutex> lock(mutex);
+        idle.notify_all();
+      }
+      continue;
+    }
+
+    std::unique_lock<std::mutex> lock(mutex);
+    wake.wait(lock, [this] { return stopping || queued > 0; });
+    if (stopping && queued == 0) {
+      return;
+    }
+  }
+}
+
+void ThreadPool::wait() {
+  std::unique_lock<std::mutex> lock(mutex);
+  idle.wait(lock, [this] { return pending == 0; });
+}
+
+void ThreadPool::wait(TaskGroup& group) {
+  std::unique_lock<std::mutex> lock(group.mutex);
+  group.idle.wait(lock, [&group] { return group.pending == 0; });
+}
+
+}  // namespace spt
@@ -0,0 +1,74 @@
+#include "Tile.hpp"
+
+#include <algorithm>
+#include <cmath>
+
+namespace spt {
+
+// position of index d on the hilbert curve filling an n x n grid, n a power of two
+static void hilbertToXY(int n, int d, int& x, int& y) {
+  x = y = 0;
+  for (int s = 1; s < n; s *= 2) {
+    int rx = 1 & (d / 2);
+    int ry = 1 & (d ^ rx);
+    // rotate the quadrant
+    if (ry == 0) {
+      if (rx == 1) {
+        x = s - 1 - x;
+        y = s - 1 - y;
+      }
+      std::swap(x, y);
+    }
+    x += s * rx;
+    y += s * ry;
+    d /= 4;
+  }
+}
+
+std::vector<Tile> makeTiles(int width, int height, int size, TileOrder order) {
+  size = std::max(1, size);
+  int nx = (width + size - 1) / size, ny = (height + size - 1) / size;
+
+  auto makeTile = [&](int tx, int ty) {
+    return Tile{tx * size, ty * size, std::min(width, (tx + 1) * size), std::min(height, (ty + 1) * size)};
+  };
+
+  std::vector<Tile> tiles;
+  tiles.reserve(nx * ny);
+
+  if (order == TILE_ORDER_HILBERT) {
+    // walk the curve over the enclosing power of two grid, skip tiles outside
+    int n = 1;
+    while (n < nx || n < ny) {
+      n *= 2;
+    }
+    for (int d = 0; d < n * n; d++) {
+      int tx, ty;
+      hilbertToXY(n, d, tx, ty);
+      if (tx < nx && ty < ny) {
+        tiles.push_back(makeTile(tx, ty));
+      }
+    }
+    return tiles;
+  }
+
+  for (int ty = 0; ty < ny; ty++) {
+    for (int tx = 0; tx < nx; tx++) {
+      tiles.push_back(makeTile(tx, ty));
+    }
+  }
+
+  if (order == TILE_ORDER_SPIRAL) {
+    // by ring around the center tile, then by angle within the ring
+    float cx = (nx - 1) * 0.5f, cy = (ny - 1) * 0.5f;
+    auto key = [&](const Tile& t) {
+      float dx = t.x0 / size - cx, dy = t.y0 / size - cy;
+      return std::make_pair(std::max(std::fabs(dx), std::fabs(dy)), std::atan2(dy, dx));
+    };
+    std::stable_sort(tiles.begin(), tiles.end(), [&](const Tile& a, const Tile& b) { return key(a) < key(b); });
+  }
+
+  return tiles;
+}
+
+}  // namespace spt
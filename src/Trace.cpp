@@ -1,8 +1,22 @@
-#include <omp.h>
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
 #include <iomanip>
+#include <sstream>
 
 #include "Trace.hpp"
+#include "ImageWriter.hpp"
 #include "Material.hpp"
+#include "ObjParser.hpp"
+#include "Progress.hpp"
+#include "SceneFile.hpp"
+#include "TextureCache.hpp"
+#include "ThreadPool.hpp"
 #include "Triangle.hpp"
 
 #define TINYOBJLOADER_IMPLEMENTATION
@@ -15,13 +29,105 @@
 #include <tinyxml2.h>
 
 namespace spt {
+// rays cast by the calling thread, flushed into the progress per tile
+static thread_local uint64_t threadRays = 0;
+// next event estimation scratch, reused across hits
+static thread_local std::vector<LightSample> threadSamples;
+static thread_local ShadowBatch threadBatch;
+
+static uint64_t splitmix(uint64_t z) {
+  z += 0x9E3779B97F4A7C15ULL;
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// random stream of a pixel starting at a sample index
+static uint64_t pixelSeed(uint64_t seed, int row, int col, uint32_t sample) {
+  return splitmix(splitmix(splitmix(seed ^ uint64_t(row)) ^ uint64_t(col)) ^ sample);
+}
+
 Tracer::Tracer(size_t _depth, size_t _samples, float _p)
-    : scene(nullptr), maxDepth(_depth), samples(_samples), maxProb(_p) {}
+    : scene(nullptr), maxDepth(_depth), samples(_samples), maxProb(_p), mode(TRACE_MIXED), allLights(false), textureLoadTime(0.0),
+      threads(0), tileSize(32), tileOrder(TILE_ORDER_HILBERT), sharedPool(false), passSamples(1), checkpointInterval(300.f),
+      adaptiveThreshold(0.f), adaptiveMinSamples(16), timeBudget(0.f), crop{0, 0, 0, 0}, sampleOffset(0), seed(0),
+      denoiseIterations(0), quiet(false), log(&std::cout) {}
+
+// shared by a render and its handles
+struct RenderState {
+  std::shared_ptr<TaskGroup> group; // tiles of this render, carries its priority
+  std::atomic<bool> cancelled;
+  std::atomic<bool> finished;
+  std::mutex mutex; // guards progress
+  std::shared_ptr<Progress> progress; // set once the render starts
+
+  explicit RenderState(int priority) : group(std::make_shared<TaskGroup>(priority)), cancelled(false), finished(false) {}
+};
+
+void RenderHandle::cancel() {
+  if (state != nullptr) {
+    state->cancelled = true;
+  }
+}
+
+void RenderHandle::setPriority(int priority) {
+  if (state != nullptr) {
+    state->group->setPriority(priority);
+  }
+}
+
+float RenderHandle::getProgress() const {
+  if (state == nullptr) {
+    return 0.f;
+  }
+  if (state->finished) {
+    return 1.f;
+  }
+  std::lock_guard<std::mutex> lock(state->mutex);
+  return state->progress != nullptr ? state->progress->getFraction() : 0.f;
+}
+
+RenderStatus RenderHandle::getStatus() const {
+  return waitFor(0.f) ? result.get() : RENDER_RUNNING;
+}
 
-bool Tracer::loadConfig(const std::string &config, std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint& illuType) {
+bool RenderHandle::waitFor(float seconds) const {
+  return result.valid() && result.wait_for(std::chrono::duration<float>(seconds)) == std::future_status::ready;
+}
+
+Tracer::~Tracer() {
+  for (auto& pending : asyncRenders) {
+    pending.wait();
+  }
+}
+
+// keyframes of an <animation> element, missing poses default to the scene camera
+static void parseAnimation(tinyxml2::XMLElement* animation, const Camera& camera, CameraPath& path, std::string& output) {
+  if (animation->Attribute("output") != nullptr) {
+    output = animation->Attribute("output");
+  }
+
+  auto vec = [](tinyxml2::XMLElement* element, const Vec3<float>& v) {
+    if (element == nullptr) {
+      return v;
+    }
+    return Vec3<float>(element->FloatAttribute("x", v.x), element->FloatAttribute("y", v.y), element->FloatAttribute("z", v.z));
+  };
+  for (auto key = animation->FirstChildElement("key"); key != nullptr; key = key->NextSiblingElement("key")) {
+    CameraKey k;
+    k.frame = key->IntAttribute("frame");
+    k.fovy = key->FloatAttribute("fovy", camera.getFovy());
+    k.eye = vec(key->FirstChildElement("eye"), camera.getEye());
+    k.lookat = vec(key->FirstChildElement("lookat"), camera.getLookAt());
+    k.up = vec(key->FirstChildElement("up"), camera.getUp());
+    path.addKey(k);
+  }
+}
+
+bool Tracer::loadConfig(const std::string &xml, const std::string &dir, std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint& illuType) {
   // xml root
   tinyxml2::XMLDocument doc;
-  doc.LoadFile(config.c_str());
+  doc.Parse(xml.c_str(), xml.size());
   if (doc.Error()) {
     return false;
   }
@@ -53,6 +159,12 @@ bool Tracer::loadConfig(const std::string &config, std::unordered_map<std::strin
     }
   }
 
+  // camera animation (optional)
+  element = doc.FirstChildElement("scene")->FirstChildElement("animation");
+  if (element != nullptr) {
+    parseAnimation(element, camera, cameraPath, frameOutput);
+  }
+
   // light radiances elements
   element = doc.FirstChildElement("scene")->FirstChildElement("light");
   while(element != nullptr) {
@@ -69,6 +181,79 @@ bool Tracer::loadConfig(const std::string &config, std::unordered_map<std::strin
     element = element->NextSiblingElement("light");
   }
 
+  // environment light (optional)
+  element = doc.FirstChildElement("scene")->FirstChildElement("environment");
+  if (element != nullptr && element->Attribute("file") != nullptr) {
+    float scale = element->FloatAttribute("scale", 1.f);
+    light.setEnvironment(std::make_shared<Environment>(dir + element->Attribute("file"), scale));
+  } else {
+    light.setEnvironment(nullptr);
+  }
+
+  // light sampling strategy (optional)
+  element = doc.FirstChildElement("scene")->FirstChildElement("lightsampler");
+  if (element != nullptr && element->Attribute("type") != nullptr && std::string(element->Attribute("type")) == "bvh") {
+    light.setSampling(LIGHT_SAMPLE_BVH);
+  } else {
+    light.setSampling(LIGHT_SAMPLE_POWER);
+  }
+
+  // integrator (optional)
+  element = doc.FirstChildElement("scene")->FirstChildElement("integrator");
+  if (element != nullptr && element->Attribute("type") != nullptr && std::string(element->Attribute("type")) == "mis") {
+    mode = TRACE_MIS;
+  } else {
+    mode = TRACE_MIXED;
+  }
+  allLights = element != nullptr && element->Attribute("lights") != nullptr && std::string(element->Attribute("lights")) == "all";
+
+  // render scheduling (optional), zero threads uses the hardware concurrency
+  element = doc.FirstChildElement("scene")->FirstChildElement("render");
+  if (element != nullptr) {
+    threads = std::max(0, element->IntAttribute("threads", int(threads)));
+    tileSize = element->IntAttribute("tilesize", tileSize);
+    const char* order = element->Attribute("order");
+    if (order != nullptr) {
+      std::string o(order);
+      tileOrder = (o == "spiral") ? TILE_ORDER_SPIRAL : (o == "scanline") ? TILE_ORDER_SCANLINE : TILE_ORDER_HILBERT;
+    }
+  }
+
+  // progressive rendering (optional), checkpoint interval in seconds
+  element = doc.FirstChildElement("scene")->FirstChildElement("progressive");
+  if (element != nullptr) {
+    passSamples = element->IntAttribute("pass", passSamples);
+    checkpointInterval = element->FloatAttribute("interval", checkpointInterval);
+    if (element->Attribute("checkpoint") != nullptr) {
+      checkpoint = element->Attribute("checkpoint");
+    }
+  }
+
+  // time budget (optional), in seconds
+  element = doc.FirstChildElement("scene")->FirstChildElement("budget");
+  if (element != nullptr) {
+    timeBudget = element->FloatAttribute("seconds", timeBudget);
+  }
+
+  // adaptive sampling (optional), spp stays the per-pixel cap
+  element = doc.FirstChildElement("scene")->FirstChildElement("adaptive");
+  if (element != nullptr) {
+    adaptiveThreshold = element->FloatAttribute("threshold", adaptiveThreshold);
+    adaptiveMinSamples = element->IntAttribute("minspp", adaptiveMinSamples);
+  }
+
+  // denoiser (optional), number of a-trous iterations
+  element = doc.FirstChildElement("scene")->FirstChildElement("denoise");
+  if (element != nullptr) {
+    denoiseIterations = std::max(0, element->IntAttribute("iterations", 5));
+  }
+
+  // out-of-core textures (optional), budget in MB
+  element = doc.FirstChildElement("scene")->FirstChildElement("texturecache");
+  if (element != nullptr) {
+    TextureCache::getInstance().setBudget(size_t(element->IntAttribute("budget", 512)) << 20);
+  }
+
   // material illumination type
   element = doc.FirstChildElement("scene")->FirstChildElement("material");
   std::string type = element->Attribute("illutype");
@@ -83,25 +268,39 @@ bool Tracer::loadConfig(const std::string &config, std::unordered_map<std::strin
   return true;
 }
 
-bool Tracer::loadModel(const std::string &model, const std::string &dir, const std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint illuType, std::vector<std::shared_ptr<Hittable>>& objects) {
+// an obj file parsed on a worker, baked into the scene on the loading thread
+struct ParsedModel {
   tinyobj::attrib_t attrib;
   std::vector<tinyobj::shape_t> shapes;
   std::vector<tinyobj::material_t> materials;
-  std::string warn;
   std::string err;
-  if (!tinyobj::LoadObj(&attrib, &shapes, &materials, &warn, &err, model.c_str(), dir.c_str())) {
-    std::cerr << err << std::endl;
-    return false;
+  bool ok = false;
+};
+
+// wall-clock span of a loading stage, its tasks may overlap those of other stages
+struct LoadStage {
+  float begin = FLT_MAX, end = 0.f;
+
+  void add(float b, float e) {
+    begin = std::min(begin, b);
+    end = std::max(end, e);
   }
+};
 
-  std::vector<Material> nmaterials;
+void Tracer::loadModel(const ParsedModel &model, const std::string &dir, const std::unordered_map<std::string, Vec3<float>> &lightRadiances, uint illuType, uint firstId, std::vector<std::shared_ptr<Hittable>>& objects) {
+  const tinyobj::attrib_t &attrib = model.attrib;
+  const std::vector<tinyobj::shape_t> &shapes = model.shapes;
+  const std::vector<tinyobj::material_t> &materials = model.materials;
+
+  // bake materials into the material table, waits for textures still decoding
+  std::vector<uint> mtlIds;
   for (const auto &material : materials) {
     Material nmaterial(material, dir, illuType);
     auto itr = lightRadiances.find(material.name);
     if (itr != lightRadiances.end()) {
       nmaterial.setEmission(itr->second);
     }
-    nmaterials.emplace_back(nmaterial);
+    mtlIds.push_back(this->materials.add(nmaterial, material.name, material.diffuse_texname));
   }
 
   for (const auto &shape : shapes) {
@@ -165,72 +364,813 @@ bool Tracer::loadModel(const std::string &model, const std::string &dir, const s
         }
       }
 
-      Material material = nmaterials[shape.mesh.material_ids[face_i]];
-      auto object = std::make_shared<Triangle>(objects.size(), points[0], points[1], points[2], point_textures[0], point_textures[1], point_textures[2], normal, material);
+      uint mtlId = mtlIds[shape.mesh.material_ids[face_i]];
+      const Material& material = this->materials[mtlId];
+      auto object = std::make_shared<Triangle>(firstId + objects.size(), points[0], points[1], points[2], point_textures[0], point_textures[1], point_textures[2], normal, mtlId);
       if (material.isEmissive()) {
-        light.setLight(object);
+        light.setLight(object, material.getEmission(), this->materials.getName(mtlId));
       }
       objects.push_back(object);
     }
   }
+}
 
-  return true;
+ThreadPool& Tracer::workerPool() {
+  // workers are kept across loads and renders unless the thread count changes,
+  // a shared pool regardless
+  if (pool == nullptr || (!sharedPool && threads != 0 && pool->size() != threads)) {
+    pool = std::make_shared<ThreadPool>(threads);
+  }
+  return *pool;
 }
 
-void Tracer::load(const std::string &dir, const std::vector<std::string> &models, const std::string &config, int bvhMinCount) {
+bool Tracer::load(const std::string &dir, const std::vector<std::string> &models, const std::string &config, int bvhMinCount) {
+  auto start = std::chrono::steady_clock::now();
+  auto since = [start] { return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count(); };
+  LoadStage configStage, parseStage, textureStage, meshStage, bvhStage, lightStage;
+  std::mutex stageMutex;
+  auto record = [&stageMutex](LoadStage& stage, float b, float e) {
+    std::lock_guard<std::mutex> lock(stageMutex);
+    stage.add(b, e);
+  };
+  auto decoded = [&](auto b, auto e) {
+    record(textureStage, std::chrono::duration<float>(b - start).count(), std::chrono::duration<float>(e - start).count());
+  };
+
   // camera, light and material type
   std::unordered_map<std::string, Vec3<float>> lightRadiances;
   uint illuType;
-  if (!loadConfig(dir+config, lightRadiances, illuType)) {
+  std::ifstream configFile(dir + config);
+  std::stringstream configText;
+  configText << configFile.rdbuf();
+  sceneDir = dir;
+  configXml = configText.str();
+  if (!configFile || !loadConfig(configXml, dir, lightRadiances, illuType)) {
     std::cerr << "Error: Config load failure (file: " << config << ")" << std::endl;
-    return;
+    return false;
   }
-  
-  // scene
-  std::vector<std::shared_ptr<Hittable>> objects;
-  for (auto model : models) {
-    if (!loadModel(dir+model, dir, lightRadiances, illuType, objects)) {
-      std::cerr << "Error: Model load failure (file: " << model << ")" << std::endl;
+  configStage.add(0.f, since());
+
+  // obj files are split into chunks parsed on the workers, the task finishing a file's last chunk
+  // merges it and queues its textures for decoding
+  ThreadPool& workers = workerPool();
+  auto group = std::make_shared<TaskGroup>();
+  std::vector<ParsedModel> parsed(models.size());
+  std::vector<std::unique_ptr<ObjParser>> parsers(models.size());
+  std::unique_ptr<std::atomic<size_t>[]> remaining(new std::atomic<size_t>[models.size()]);
+  std::vector<char> done(models.size(), 0);
+  std::condition_variable parsedOne;
+  size_t parseBytes = 0;
+  auto finish = [&](size_t i) {
+    float b = since();
+    ParsedModel& model = parsed[i];
+    std::string warn;
+    model.ok = parsers[i]->finish(dir, model.attrib, model.shapes, model.materials, warn, model.err);
+    parsers[i].reset();
+    record(parseStage, b, since());
+
+    std::vector<std::string> texNames;
+    for (const auto &material : model.materials) {
+      if (!material.diffuse_texname.empty()) {
+        texNames.push_back(dir + material.diffuse_texname);
+      }
+    }
+    Texture::preload(texNames, workers, group, decoded);
+
+    std::lock_guard<std::mutex> lock(stageMutex);
+    done[i] = 1;
+    parsedOne.notify_all();
+  };
+  std::vector<std::function<void()>> tasks;
+  for (size_t i = 0; i < models.size(); i++) {
+    parsers[i] = std::make_unique<ObjParser>();
+    if (!parsers[i]->open(dir + models[i])) {
+      parsed[i].err = "Cannot open file (file: " + dir + models[i] + ")";
+      done[i] = 1;
+      continue;
+    }
+    parseBytes += parsers[i]->getFileSize();
+    remaining[i] = parsers[i]->getChunkCount();
+    if (remaining[i] == 0) {
+      tasks.push_back([&, i] { finish(i); });
+    }
+    for (size_t k = 0; k < parsers[i]->getChunkCount(); k++) {
+      tasks.push_back([&, i, k] {
+        float b = since();
+        parsers[i]->parseChunk(k);
+        record(parseStage, b, since());
+        if (--remaining[i] == 0) {
+          finish(i);
+        }
+      });
+    }
+  }
+  workers.submit(std::move(tasks), group);
+
+  // materials, triangles and lights are baked here in file order, so ids match a serial load;
+  // each mesh's bvh is queued as soon as its triangles exist
+  std::vector<std::shared_ptr<Hittable>> meshes(models.size());
+  uint triangleCount = 0;
+  bool ok = true;
+  for (size_t i = 0; i < models.size() && ok; i++) {
+    {
+      std::unique_lock<std::mutex> lock(stageMutex);
+      parsedOne.wait(lock, [&done, i] { return done[i] != 0; });
+    }
+    if (!parsed[i].ok) {
+      std::cerr << parsed[i].err << std::endl;
+      std::cerr << "Error: Model load failure (file: " << models[i] << ")" << std::endl;
+      ok = false;
+      break;
+    }
+
+    float b = since();
+    std::vector<std::shared_ptr<Hittable>> objects;
+    loadModel(parsed[i], dir, lightRadiances, illuType, triangleCount, objects);
+    triangleCount += objects.size();
+    parsed[i] = ParsedModel();
+    record(meshStage, b, since());
+
+    if (!objects.empty()) {
+      std::vector<std::function<void()>> build;
+      build.push_back([&, i, objects = std::move(objects)]() mutable {
+        float b = since();
+        meshes[i] = BVH::constructBVH(objects, 0, objects.size(), bvhMinCount);
+        record(bvhStage, b, since());
+      });
+      workers.submit(std::move(build), group);
+    }
+  }
+  workers.wait(*group);
+  if (!ok) {
+    return false;
+  }
+
+  // top level over the meshes
+  float b = since();
+  meshes.erase(std::remove(meshes.begin(), meshes.end(), nullptr), meshes.end());
+  if (meshes.empty()) {
+    scene = BVH::constructBVH(meshes, 0, 0, bvhMinCount);
+  } else {
+    scene = BVH::combine(meshes, 0, meshes.size());
+  }
+  bvhStage.add(b, since());
+
+  // light sampling tables
+  b = since();
+  light.build();
+  lightStage.add(b, since());
+  textureLoadTime += textureStage.end > textureStage.begin ? textureStage.end - textureStage.begin : 0.f;
+
+  // info
+  print();
+  auto span = [this](const char* name, const LoadStage& stage) {
+    *log << name << ' ';
+    if (stage.end < stage.begin) {
+      *log << "-, ";
       return;
     }
+    *log << stage.begin << '-' << stage.end << "s, ";
+  };
+  std::ios logFormat(nullptr);
+  logFormat.copyfmt(*log);
+  *log << std::fixed << std::setprecision(2) << "Load: ";
+  span("config", configStage);
+  span("parse", parseStage);
+  if (parseStage.end > parseStage.begin) {
+    *log << parseBytes / 1e6f / (parseStage.end - parseStage.begin) << "MB/s, ";
   }
-  scene = BVH::constructBVH(objects, 0, objects.size(), bvhMinCount);
+  span("textures", textureStage);
+  span("meshes", meshStage);
+  span("bvh", bvhStage);
+  span("lights", lightStage);
+  *log << "first pixel after " << since() << "s\n";
+  log->copyfmt(logFormat);
+  return true;
+}
+
+bool Tracer::saveCompiled(const std::string &fileName) const {
+  if (scene == nullptr) {
+    return false;
+  }
+
+  // bvh as loaded, triangles by id; every triangle sits in exactly one leaf
+  std::vector<BVHNodeRecord> nodes;
+  std::vector<const Hittable*> leafObjects;
+  scene->flatten(nodes, leafObjects);
+  std::vector<TriangleRecord> triangles(leafObjects.size());
+  std::vector<uint32_t> objectIds;
+  objectIds.reserve(leafObjects.size());
+  for (const Hittable* object : leafObjects) {
+    size_t id = object->getId();
+    if (id >= triangles.size()) {
+      return false;
+    }
+    triangles[id] = static_cast<const Triangle*>(object)->getRecord();
+    objectIds.push_back(id);
+  }
+
+  std::vector<Material> records;
+  std::vector<std::string> names, textures;
+  for (uint i = 0; i < materials.size(); i++) {
+    records.push_back(materials[i].unlinked());
+    names.push_back(materials.getName(i));
+    textures.push_back(materials.getTexture(i));
+  }
+  std::vector<uint32_t> lights;
+  for (ulong i = 0; i < light.getSize(); i++) {
+    lights.push_back(light.getTriangle(i)->getId());
+  }
+
+  // the scene dir is kept relative to the compiled file, so both can move together
+  namespace fs = std::filesystem;
+  std::error_code ec;
+  fs::path base = fs::absolute(fs::path(fileName), ec).parent_path();
+  fs::path relative = fs::relative(fs::absolute(fs::path(sceneDir.empty() ? "." : sceneDir), ec), base, ec);
+  std::string dir = (ec || relative.empty()) ? sceneDir : relative.string();
+
+  SceneWriter writer;
+  if (!writer.open(fileName)) {
+    return false;
+  }
+  SceneHeader& header = writer.getHeader();
+  writer.addStrings(header.config, {configXml});
+  writer.addStrings(header.dir, {dir});
+  writer.add(header.materials, records);
+  writer.addStrings(header.materialNames, names);
+  writer.addStrings(header.textureNames, textures);
+  writer.add(header.triangles, triangles);
+  writer.add(header.nodes, nodes);
+  writer.add(header.objectIds, objectIds);
+  writer.add(header.lights, lights);
+  return writer.close();
+}
+
+bool Tracer::loadCompiled(const std::string &fileName) {
+  auto start = std::chrono::steady_clock::now();
+  auto since = [start] { return std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count(); };
+  LoadStage mapStage, configStage, textureStage, materialStage, triangleStage, bvhStage, lightStage;
+
+  SceneFile file;
+  if (!file.open(fileName)) {
+    std::cerr << "Error: Compiled scene load failure (file: " << fileName << ")" << std::endl;
+    return false;
+  }
+  const SceneHeader& header = file.getHeader();
+  mapStage.add(0.f, since());
+
+  // camera, light and material type; radiances and the illumination type are baked in the materials
+  float b = since();
+  std::string dir = file.getStrings(header.dir).front();
+  dir = (std::filesystem::path(fileName).parent_path() / dir / "").string();
+  sceneDir = dir;
+  configXml = file.getStrings(header.config).front();
+  std::unordered_map<std::string, Vec3<float>> lightRadiances;
+  uint illuType;
+  if (!loadConfig(configXml, dir, lightRadiances, illuType)) {
+    std::cerr << "Error: Config load failure (file: " << fileName << ")" << std::endl;
+    return false;
+  }
+  configStage.add(b, since());
+
+  // textures decode on the workers, materials link to them once all are in
+  std::vector<std::string> names = file.getStrings(header.materialNames);
+  std::vector<std::string> textures = file.getStrings(header.textureNames);
+  ThreadPool& workers = workerPool();
+  auto group = std::make_shared<TaskGroup>();
+  std::mutex stageMutex;
+  std::vector<std::string> texNames;
+  for (const std::string& texture : textures) {
+    if (!texture.empty()) {
+      texNames.push_back(dir + texture);
+    }
+  }
+  Texture::preload(texNames, workers, group, [&](auto b, auto e) {
+    std::lock_guard<std::mutex> lock(stageMutex);
+    textureStage.add(std::chrono::duration<float>(b - start).count(), std::chrono::duration<float>(e - start).count());
+  });
+  workers.wait(*group);
+
+  b = since();
+  const Material* records = file.get<Material>(header.materials);
+  for (size_t i = 0; i < header.materials.count; i++) {
+    Material material = records[i];
+    material.link(textures[i].empty() ? nullptr : Texture::getInstance(dir + textures[i]));
+    materials.add(material, names[i], textures[i]);
+  }
+  materialStage.add(b, since());
+
+  // triangles in one array, the bvh and lights refer to them through aliasing pointers
+  b = since();
+  const TriangleRecord* triangleRecords = file.get<TriangleRecord>(header.triangles);
+  auto storage = std::make_shared<std::vector<Triangle>>();
+  storage->reserve(header.triangles.count);
+  for (size_t i = 0; i < header.triangles.count; i++) {
+    storage->emplace_back(i, triangleRecords[i]);
+  }
+  std::vector<std::shared_ptr<Hittable>> objects(storage->size());
+  for (size_t i = 0; i < storage->size(); i++) {
+    objects[i] = std::shared_ptr<Hittable>(storage, &(*storage)[i]);
+  }
+  triangleStage.add(b, since());
+
+  b = since();
+  scene = BVH::restore(file.get<BVHNodeRecord>(header.nodes), file.get<uint32_t>(header.objectIds), objects);
+  bvhStage.add(b, since());
+
+  b = since();
+  const uint32_t* lights = file.get<uint32_t>(header.lights);
+  for (size_t i = 0; i < header.lights.count; i++) {
+    auto triangle = std::static_pointer_cast<Triangle>(objects[lights[i]]);
+    uint mtlId = triangle->getMaterialId();
+    light.setLight(triangle, materials[mtlId].getEmission(), materials.getName(mtlId));
+  }
+  light.build();
+  lightStage.add(b, since());
+  textureLoadTime += textureStage.end > textureStage.begin ? textureStage.end - textureStage.begin : 0.f;
 
   // info
   print();
+  auto span = [this](const char* name, const LoadStage& stage) {
+    *log << name << ' ';
+    if (stage.end < stage.begin) {
+      *log << "-, ";
+      return;
+    }
+    *log << stage.begin << '-' << stage.end << "s, ";
+  };
+  std::ios logFormat(nullptr);
+  logFormat.copyfmt(*log);
+  *log << std::fixed << std::setprecision(2) << "Load: compiled " << file.getFileSize() / 1e6f << "MB, ";
+  span("map", mapStage);
+  span("config", configStage);
+  span("textures", textureStage);
+  span("materials", materialStage);
+  span("triangles", triangleStage);
+  span("bvh", bvhStage);
+  span("lights", lightStage);
+  *log << "first pixel after " << since() << "s\n";
+  log->copyfmt(logFormat);
+  return true;
 }
 
-void Tracer::render(const std::string& imgName) {
-  int h = camera.getHeight(), w = camera.getWidth();
-  std::vector<uint8_t> img(h * w * 3);
+void Tracer::setPool(std::shared_ptr<ThreadPool> shared) {
+  pool = std::move(shared);
+  threads = pool->size();
+  sharedPool = true;
+}
+
+bool Tracer::loadAnimation(const std::string& file) {
+  tinyxml2::XMLDocument doc;
+  doc.LoadFile(file.c_str());
+  if (doc.Error()) {
+    return false;
+  }
+
+  // <animation> as the root or inside a <scene>
+  tinyxml2::XMLElement* element = doc.FirstChildElement("animation");
+  if (element == nullptr && doc.FirstChildElement("scene") != nullptr) {
+    element = doc.FirstChildElement("scene")->FirstChildElement("animation");
+  }
+  if (element == nullptr) {
+    return false;
+  }
+  parseAnimation(element, camera, cameraPath, frameOutput);
+  return true;
+}
+
+bool Tracer::isConverged(const Film& source, int row, int col) const {
+  return adaptiveThreshold > 0.f && source.getCount(row, col) >= uint32_t(adaptiveMinSamples) &&
+         source.getError(row, col) < adaptiveThreshold;
+}
+
+void Tracer::renderTile(Film& out, const Tile& tile, uint32_t target, const std::atomic<bool>& cancelled) {
+  uint64_t tileSamples = 0;
+  for (int row = tile.y0; row < tile.y1 && !cancelled; row++) {
+    for (int col = tile.x0; col < tile.x1; col++) {
+      // a resumed film may already hold some of the samples
+      uint32_t count = out.getCount(row, col);
+      if (count >= target || isConverged(out, row, col)) {
+        continue;
+      }
+
+      // reproducible, and processes rendering disjoint sample ranges never repeat samples
+      seedRand(pixelSeed(seed, row, col, sampleOffset + count));
 
-#pragma omp parallel for num_threads(30)
-  for (int row = 0; row < h; row++) {
-    for (int col = 0; col < w; col++) {
       Vec3<float> color(0, 0, 0);
-      for (int k = 0; k < samples; k++) {
+      double lumSum = 0.0, lumSq = 0.0;
+      for (uint32_t k = count; k < target; k++) {
+        Ray ray = camera.getRay(row, col);
+        Vec3<float> radiance = (mode == TRACE_MIS) ? traceMIS(ray) : trace(ray, 0);
+        double lum = luminance(radiance);
+        color += radiance;
+        lumSum += lum;
+        lumSq += lum * lum;
+      }
+      out.add(row, col, color, lumSum, lumSq, target - count);
+      tileSamples += target - count;
+    }
+  }
+
+  // one batched update per tile keeps the counters off the pixel loop
+  progress->add(tileSamples, threadRays);
+  threadRays = 0;
+}
+
+void Tracer::renderFeatures(const Tile& tile) {
+  const int featureSamples = 4;
+  int w = features.width;
+  for (int row = tile.y0; row < tile.y1; row++) {
+    for (int col = tile.x0; col < tile.x1; col++) {
+      Vec3<float> albedo(0, 0, 0), normal(0, 0, 0);
+      float depth = 0.f;
+      for (int k = 0; k < featureSamples; k++) {
         Ray ray = camera.getRay(row, col);
-        color += trace(ray, 0);
+        HitResult res;
+        scene->hit(ray, res);
+        threadRays++;
+
+        // misses count as white, normal and depth stay zero
+        if (!res.hit) {
+          albedo += Vec3<float>(1, 1, 1);
+          continue;
+        }
+        albedo += materials[res.mtlId].getBaseColor(res.uv, res.footprint);
+        normal += res.normal;
+        depth += res.distance;
+      }
+
+      int idx = row * w + col;
+      features.albedo[idx] = albedo / featureSamples;
+      features.normal[idx] = normal.length() > 0.f ? normalize(normal) : normal;
+      features.depth[idx] = depth / featureSamples;
+    }
+  }
+
+  progress->add(0, threadRays);
+  threadRays = 0;
+}
+
+// final pixels of a tile to the streamed image, one write per tile row, and to the tile callback
+template <typename F>
+static bool emitTile(const ImageWriter& writer, const TileCallback& onTile, const Tile& tile, F pixel) {
+  int tw = tile.x1 - tile.x0;
+  std::vector<Vec3<float>> pixels(tw * (tile.y1 - tile.y0));
+  for (int row = tile.y0; row < tile.y1; row++) {
+    for (int col = tile.x0; col < tile.x1; col++) {
+      pixels[(row - tile.y0) * tw + col - tile.x0] = pixel(row, col);
+    }
+  }
+
+  bool ok = true;
+  for (int row = tile.y0; row < tile.y1 && ok && writer.isOpen(); row++) {
+    ok = writer.writeRow(row, tile.x0, &pixels[(row - tile.y0) * tw], tw);
+  }
+  if (onTile) {
+    onTile(tile, pixels.data());
+  }
+  return ok;
+}
+
+bool Tracer::render(const std::string& imgName) {
+  RenderState state(0);
+  return run(imgName, nullptr, state) == RENDER_DONE;
+}
+
+RenderHandle Tracer::renderAsync(const std::string& imgName, TileCallback onTile, int priority) {
+  // finished renders need no waiting for anymore
+  asyncRenders.erase(std::remove_if(asyncRenders.begin(), asyncRenders.end(),
+                                    [](const std::shared_future<RenderStatus>& r) {
+                                      return r.wait_for(std::chrono::seconds(0)) == std::future_status::ready;
+                                    }),
+                     asyncRenders.end());
+
+  auto state = std::make_shared<RenderState>(priority);
+  std::shared_future<RenderStatus> result =
+      std::async(std::launch::async, [this, imgName, onTile, state] { return run(imgName, onTile, *state); }).share();
+  asyncRenders.push_back(result);
+  return RenderHandle(state, result);
+}
+
+RenderStatus Tracer::run(const std::string& imgName, const TileCallback& onTile, RenderState& state) {
+  std::lock_guard<std::mutex> renderLock(renderMutex);
+  const std::shared_ptr<TaskGroup>& group = state.group;
+  const std::atomic<bool>& cancelled = state.cancelled;
+
+  int h = camera.getHeight(), w = camera.getWidth();
+
+  // crop window of a distributed render, the whole frame by default
+  Tile window = {0, 0, w, h};
+  if (crop.getArea() > 0) {
+    window.x0 = std::clamp(crop.x0, 0, w);
+    window.y0 = std::clamp(crop.y0, 0, h);
+    window.x1 = std::clamp(crop.x1, window.x0, w);
+    window.y1 = std::clamp(crop.y1, window.y0, h);
+  }
+  int area = window.getArea();
+  bool cropped = area != w * h;
+
+  // float formats stream finished tiles into a presized file instead of an 8-bit copy
+  // no file without a name, tiles then only go to the callback
+  bool toFile = !imgName.empty();
+  ImageFormat format = ImageWriter::getFormat(imgName);
+  ImageWriter writer;
+  bool written = true;
+  if (toFile && (format == IMAGE_PFM || format == IMAGE_EXR) && !writer.open(imgName, w, h, format)) {
+    std::cerr << "Error: Image open failure (file: " << imgName << ")" << std::endl;
+    written = false;
+  }
+  std::atomic<bool> writeFailed(false);
+  bool streamed = false;
+  auto filmPixel = [this](int row, int col) { return film.getPixel(row, col); };
+  bool denoise = denoiseIterations > 0 && !cropped && format != IMAGE_FILM;
+
+  // a single fixed pass into a float file never reads the frame back, so no frame film is kept;
+  // each tile is rendered into a film of its own and written out when done
+  bool budgeted = timeBudget > 0.f;
+  bool direct = writer.isOpen() && !denoise && !budgeted && checkpoint.empty() && adaptiveThreshold <= 0.f &&
+                (passSamples <= 0 || size_t(passSamples) >= samples);
+
+  // resume from the checkpoint if it matches this image
+  film = direct ? Film() : Film(window.x1 - window.x0, window.y1 - window.y0, window.x0, window.y0, w, h);
+  if (!checkpoint.empty() && film.load(checkpoint)) {
+    *log << "Resumed " << checkpoint << " at " << film.getMinCount() << " spp\n";
+  }
+
+  workerPool();
+
+  // frame tiles clipped to the window, the order stays that of the frame
+  std::vector<Tile> tiles;
+  for (Tile tile : makeTiles(w, h, tileSize, tileOrder)) {
+    tile = {std::max(tile.x0, window.x0), std::max(tile.y0, window.y0), std::min(tile.x1, window.x1),
+            std::min(tile.y1, window.y1)};
+    if (tile.x0 < tile.x1 && tile.y0 < tile.y1) {
+      tiles.push_back(tile);
+    }
+  }
+  uint32_t target = std::min<uint32_t>(film.getMinCount(), samples);
+  auto lastCheckpoint = std::chrono::steady_clock::now();
+
+  // a time budget keeps adding passes until the deadline, spp no longer caps them
+  uint64_t total = uint64_t(area) * samples;
+  progress = std::make_shared<Progress>(total - std::min(total, film.getTotalCount()), timeBudget, quiet);
+  {
+    std::lock_guard<std::mutex> lock(state.mutex);
+    state.progress = progress;
+  }
+  auto elapsed = [this] { return progress->getElapsed(); };
+  uint32_t cap = budgeted ? UINT32_MAX : samples;
+  float lastPass = 0.f;
+
+  // denoiser guides, a few primary rays per pixel; partials keep their raw samples for merging
+  if (denoiseIterations > 0 && !denoise) {
+    *log << "Denoise: skipped for partial renders\n";
+  }
+  if (denoise) {
+    features = FeatureBuffer(w, h);
+    std::vector<std::function<void()>> tasks;
+    for (const Tile& tile : tiles) {
+      tasks.push_back([this, tile] { renderFeatures(tile); });
+    }
+    pool->submit(std::move(tasks), group);
+    pool->wait(*group);
+  }
+
+  if (direct) {
+    std::vector<std::function<void()>> tasks;
+    for (const Tile& tile : tiles) {
+      tasks.push_back([this, tile, w, h, &onTile, &cancelled, &writer, &writeFailed] {
+        Film part(tile.x1 - tile.x0, tile.y1 - tile.y0, tile.x0, tile.y0, w, h);
+        renderTile(part, tile, uint32_t(samples), cancelled);
+        auto partPixel = [&part](int row, int col) { return part.getPixel(row, col); };
+        if (!cancelled && !emitTile(writer, onTile, tile, partPixel)) {
+          writeFailed = true;
+        }
+      });
+    }
+    pool->submit(std::move(tasks), group);
+    pool->wait(*group);
+    streamed = true;
+  }
+
+  // progressive passes, each raises the per-pixel target by passSamples spp
+  while (!direct && target < cap && !cancelled) {
+    // only start a pass that is expected to end before the deadline
+    if (budgeted && target > 0 && elapsed() + lastPass > timeBudget) {
+      break;
+    }
+    float passStart = elapsed();
+
+    target = std::min<uint32_t>(target + (passSamples > 0 ? passSamples : samples), cap);
+
+    // adaptive sampling skips tiles whose pixels all converged
+    std::vector<Tile> active, idle;
+    for (const Tile& tile : tiles) {
+      bool busy = false;
+      for (int row = tile.y0; row < tile.y1 && !busy; row++) {
+        for (int col = tile.x0; col < tile.x1 && !busy; col++) {
+          busy = film.getCount(row, col) < target && !isConverged(film, row, col);
+        }
+      }
+      (busy ? active : idle).push_back(tile);
+    }
+    if (active.empty()) {
+      break;
+    }
+
+    // one task per tile, the pool balances uneven tiles by stealing,
+    // in the last pass each tile is written out as soon as it is final
+    bool last = (writer.isOpen() || onTile) && !denoise && !budgeted && target == samples;
+    std::vector<std::function<void()>> tasks;
+    for (const Tile& tile : active) {
+      tasks.push_back([this, tile, target, last, filmPixel, &onTile, &cancelled, &writer, &writeFailed] {
+        renderTile(film, tile, target, cancelled);
+        if (last && !cancelled && !emitTile(writer, onTile, tile, filmPixel)) {
+          writeFailed = true;
+        }
+      });
+    }
+    for (const Tile& tile : idle) {
+      if (last) {
+        tasks.push_back([tile, filmPixel, &onTile, &cancelled, &writer, &writeFailed] {
+          if (!cancelled && !emitTile(writer, onTile, tile, filmPixel)) {
+            writeFailed = true;
+          }
+        });
+      }
+    }
+    streamed = last;
+    pool->submit(std::move(tasks), group);
+    pool->wait(*group);
+    lastPass = elapsed() - passStart;
+
+    // periodic checkpoint
+    auto now = std::chrono::steady_clock::now();
+    if (!checkpoint.empty() && std::chrono::duration<float>(now - lastCheckpoint).count() >= checkpointInterval) {
+      if (!film.save(checkpoint)) {
+        std::cerr << "Error: Checkpoint save failure (file: " << checkpoint << ")" << std::endl;
+      }
+      lastCheckpoint = now;
+    }
+  }
+
+  // final checkpoint, a later run may resume it with more samples
+  if (!checkpoint.empty() && !film.save(checkpoint)) {
+    std::cerr << "Error: Checkpoint save failure (file: " << checkpoint << ")" << std::endl;
+  }
+
+  // achieved quality and throughput
+  progress->finish();
+  float seconds = elapsed();
+  uint64_t rays = progress->getRays();
+  // reports are formatted locally, so the log keeps the caller's format
+  std::ostringstream report;
+  uint64_t sampled = direct ? progress->getSamples() : film.getTotalCount();
+  report << "Samples: " << std::fixed << std::setprecision(1) << double(sampled) / area
+         << " spp on average, " << rays << " rays in " << seconds << "s ("
+         << rays / std::max(seconds, 1e-6f) * 1e-6 << " Mrays/s)\n";
+  *log << report.str();
+
+  // a cancelled render leaves its samples to the checkpoint, a half-written image is removed
+  if (cancelled) {
+    *log << "Cancelled\n";
+    if (writer.isOpen()) {
+      writer.close();
+      std::remove(imgName.c_str());
+    }
+    state.finished = true;
+    return RENDER_CANCELLED;
+  }
+
+  // denoise the final film, the output then comes from the filtered image
+  std::vector<Vec3<float>> image;
+  if (denoise) {
+    image = film.getImage();
+    std::vector<float> variances(w * h);
+    for (int row = 0; row < h; row++) {
+      for (int col = 0; col < w; col++) {
+        variances[row * w + col] = film.getVariance(row, col);
       }
-      color /= samples;
-      
-      // gamma correction
-      float gamma = 1.0f/2.2f;
-      color = pow<float>(color, gamma) * 255.f;
+    }
 
-      int idx = (row * w + col ) * 3;      
-      img[idx + 0] = std::min(255.f, color.x);
-      img[idx + 1] = std::min(255.f, color.y);
-      img[idx + 2] = std::min(255.f, color.z);
+    // monte carlo variance falls as 1/spp, so the variance reduction scales the spp
+    auto start = std::chrono::steady_clock::now();
+    float reduction = Denoiser(denoiseIterations).denoise(image, variances, features, *pool);
+    double spp = double(film.getTotalCount()) / area;
+    std::ostringstream report;
+    report << "Denoise: " << std::fixed << std::setprecision(2)
+           << std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() << "s, "
+           << "noise variance reduced up to " << reduction << "x, equal-noise estimate without it "
+           << std::setprecision(0) << spp * reduction << " spp (upper bound, from the filter weights)\n";
+    *log << report.str();
+  }
+  auto imagePixel = [&image, w](int row, int col) { return image[row * w + col]; };
 
-      // show progress
-      float percent = 100.f * (row * w + col) / (h * w - 1);
-      showProgress(percent);
+  // denoised, budgeted or fully converged renders only know the final image now
+  if ((writer.isOpen() || onTile) && !streamed) {
+    std::vector<std::function<void()>> tasks;
+    for (const Tile& tile : tiles) {
+      tasks.push_back([tile, filmPixel, imagePixel, &image, &onTile, &writer, &writeFailed] {
+        bool ok = image.empty() ? emitTile(writer, onTile, tile, filmPixel) : emitTile(writer, onTile, tile, imagePixel);
+        if (!ok) {
+          writeFailed = true;
+        }
+      });
     }
+    pool->submit(std::move(tasks), group);
+    pool->wait(*group);
   }
 
-  int result = stbi_write_png(imgName.c_str(), w, h, 3, img.data(), w*3);
-  return ;
+  if (writer.isOpen()) {
+    if (!writer.close() || writeFailed) {
+      std::cerr << "Error: Image write failure (file: " << imgName << ")" << std::endl;
+      written = false;
+    }
+  } else if (toFile && format == IMAGE_FILM) {
+    if (!film.save(imgName)) {
+      std::cerr << "Error: Partial save failure (file: " << imgName << ")" << std::endl;
+      written = false;
+    }
+  } else if (toFile && format == IMAGE_PNG) {
+    // a cropped png holds just the window
+    int cw = film.getWidth(), ch = film.getHeight();
+    std::vector<uint8_t> img = image.empty() ? film.toImage() : Film::toImage(image);
+    if (!stbi_write_png(imgName.c_str(), cw, ch, 3, img.data(), cw*3)) {
+      std::cerr << "Error: Image write failure (file: " << imgName << ")" << std::endl;
+      written = false;
+    }
+  }
+
+  // texture cache
+  if (TextureCache::getInstance().isEnabled()) {
+    auto stats = TextureCache::getInstance().getStats();
+    uint64_t lookups = stats.hits + stats.misses;
+    std::ostringstream report;
+    report << "Texture cache: hit rate " << std::fixed << std::setprecision(2)
+           << (lookups ? 100.0 * stats.hits / lookups : 100.0) << "% "
+           << "resident " << (stats.residentBytes >> 20) << "MB "
+           << "evictions " << stats.evictions << ' '
+           << "stall " << stats.stallSeconds << "s\n";
+    *log << report.str();
+  }
+  state.finished = true;
+  return written ? RENDER_DONE : RENDER_FAILED;
+}
+
+// pattern with its last run of # replaced by the zero-padded frame, or _#### before the extension
+static std::string frameName(const std::string& pattern, int frame) {
+  std::string name = pattern;
+  size_t end = name.find_last_of('#');
+  if (end == std::string::npos) {
+    size_t dot = name.find_last_of('.');
+    name.insert(dot == std::string::npos ? name.size() : dot, "_####");
+    end = name.find_last_of('#');
+  }
+  size_t begin = name.find_last_not_of('#', end);
+  begin = (begin == std::string::npos) ? 0 : begin + 1;
+
+  std::string number = std::to_string(frame);
+  size_t width = end - begin + 1;
+  if (number.size() < width) {
+    number.insert(0, width - number.size(), '0');
+  }
+  return name.replace(begin, width, number);
+}
+
+void Tracer::renderSequence(const std::string& pattern, int first, int last) {
+  if (cameraPath.empty()) {
+    std::cerr << "Error: Animation without camera keys" << std::endl;
+    return;
+  }
+  std::string output = !pattern.empty() ? pattern : !frameOutput.empty() ? frameOutput : "frame_####.png";
+  first = std::max(first, cameraPath.getFirstFrame());
+  last = std::min(last, cameraPath.getLastFrame());
+
+  // every frame gets its own checkpoint and random streams
+  std::string baseCheckpoint = checkpoint;
+  uint64_t baseSeed = seed;
+
+  double total = 0.0;
+  for (int frame = first; frame <= last; frame++) {
+    cameraPath.apply(camera, float(frame));
+    if (!baseCheckpoint.empty()) {
+      checkpoint = frameName(baseCheckpoint, frame);
+    }
+    seed = baseSeed + frame;
+
+    std::string name = frameName(output, frame);
+    *log << "Frame " << frame << " (" << name << ")\n";
+    auto start = std::chrono::steady_clock::now();
+    render(name);
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    total += seconds;
+    *log << "Frame " << frame << " time: " << seconds << "s\n";
+  }
+
+  checkpoint = baseCheckpoint;
+  seed = baseSeed;
+  int count = std::max(0, last - first + 1);
+  *log << "Sequence: " << count << " frames in " << total << "s, " << (count ? total / count : 0.0) << "s per frame\n";
 }
 
 Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
@@ -241,11 +1181,12 @@ Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
 
   HitResult res;
   scene->hit(rayv, res);
+  threadRays++;
 
   if (!res.hit) {
-    return Vec3<float>(0, 0, 0);
+    return light.getEnvironmentRadiance(rayv.getDirection());
   }
-  assert(res.id >= 0 && res.id < scene->getSize());
+  assert(res.id >= 0 && uint(res.id) < scene->getSize());
 
   // view direction
   Vec3<float> V = -rayv.getDirection(); // P -> Eye
@@ -254,7 +1195,7 @@ Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
   Vec3<float>& N = res.normal;
   Vec3<float>& P = res.point;
   Vec2<float>& UV = res.uv;
-  Material& mtl = res.material;
+  const Material& mtl = materials[res.mtlId];
   float dis = res.distance;
   
   // P = P + N * EPSILON; // move, because of percision
@@ -269,7 +1210,8 @@ Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
 
   if (rand(1.f) < 0.5f) {
     // sample light
-    std::tie(L, PDF) = light.sample(scene, P);
+    std::tie(L, PDF) = light.sample(scene, P, N);
+    threadRays++;
   } else {
     // sample bsdf
     std::tie(L, PDF) = mtl.scatter(V, N);
@@ -279,12 +1221,13 @@ Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
     return Vec3<float>(0.f, 0.f, 0.f);
   }
 
-  Ray rayl(P, L);
+  // continue the ray cone, flat triangles keep its spread
+  Ray rayl(P, L, rayv.getWidthAt(res.distance), rayv.getSpread());
   // input light
   Vec3<float> L_i = trace(rayl, depth+1);
   
   // evaluate BSDF
-  Vec3<float> BSDF = mtl.bsdf(V, N, L, UV);
+  Vec3<float> BSDF = mtl.bsdf(V, N, L, UV, res.footprint);
 
   // incident cosine
   float NdotL = ::fabsf(dot(N, L));
@@ -298,29 +1241,142 @@ Vec3<float> Tracer::trace(const Ray &rayv, size_t depth) {
   return L_o;
 }
 
+Vec3<float> Tracer::traceMIS(const Ray &rayv) {
+  assert(scene != nullptr);
+
+  Vec3<float> radiance(0.f, 0.f, 0.f);
+  Vec3<float> beta(1.f, 1.f, 1.f); // path throughput
+  Ray ray = rayv;
+
+  // previous vertex info for weighting emission found by bsdf sampling
+  Vec3<float> prevP, prevN;
+  float prevPdf = 0.f;
+  bool prevSpecular = true;
+
+  for (size_t depth = 0; depth < maxDepth; depth++) {
+    HitResult res;
+    scene->hit(ray, res);
+    threadRays++;
+
+    if (!res.hit) {
+      // environment, weighted against the light sampling strategy of the previous vertex
+      if (light.hasEnvironment()) {
+        Vec3<float> L_env = light.getEnvironmentRadiance(ray.getDirection());
+        if (prevSpecular) {
+          radiance += beta * L_env;
+        } else {
+          float pdfLight = light.pdfEnvironment(ray.getDirection(), allLights);
+          radiance += beta * L_env * powerHeuristic(prevPdf, pdfLight);
+        }
+      }
+      break;
+    }
+    assert(res.id >= 0 && uint(res.id) < scene->getSize());
+
+    // view direction
+    Vec3<float> V = -ray.getDirection(); // P -> Eye
+
+    // hit info
+    Vec3<float>& N = res.normal;
+    Vec3<float>& P = res.point;
+    Vec2<float>& UV = res.uv;
+    const Material& mtl = materials[res.mtlId];
+
+    // emission, weighted against the light sampling strategy of the previous vertex
+    if (mtl.isEmissive()) {
+      if (prevSpecular) {
+        radiance += beta * mtl.getEmission();
+      } else {
+        float pdfLight = light.pdf(prevP, prevN, res.id, P, allLights);
+        radiance += beta * mtl.getEmission() * powerHeuristic(prevPdf, pdfLight);
+      }
+    }
+
+    bool specular = mtl.isSpecular();
+
+    // next event estimation (delta lobes cannot be hit by light samples)
+    if (!specular) {
+      std::vector<LightSample>& samples = threadSamples;
+      if (allLights) {
+        light.sampleAll(scene, P, samples, threadBatch);
+      } else {
+        samples.assign(1, light.sampleLi(scene, P, N));
+      }
+      threadRays += samples.size();
+
+      // evaluate the bsdf of the light samples 8 at a time
+      for (size_t beg = 0; beg < samples.size(); beg += 8) {
+        size_t count = std::min<size_t>(8, samples.size() - beg);
+        Vec3<float> dirs[8], BSDFs[8];
+        for (size_t i = 0; i < count; i++) {
+          dirs[i] = samples[beg + i].dir;
+        }
+        mtl.bsdf(V, N, dirs, count, UV, BSDFs, res.footprint);
+
+        for (size_t i = 0; i < count; i++) {
+          const auto& ls = samples[beg + i];
+          if (ls.pdf <= EPSILON) {
+            continue;
+          }
+          float pdfBSDF = mtl.pdf(V, N, ls.dir);
+          float NdotL = ::fabsf(dot(N, ls.dir));
+          radiance += beta * ls.emission * BSDFs[i] * (NdotL * powerHeuristic(ls.pdf, pdfBSDF) / ls.pdf);
+        }
+      }
+    }
+
+    // bsdf sampling
+    auto [L, PDF] = mtl.scatter(V, N);
+    if (L == Vec3(0.f, 0.f, 0.f) || PDF < EPSILON) {
+      break;
+    }
+    if (!specular) {
+      // mixture density of all lobes scatter may choose
+      PDF = mtl.pdf(V, N, L);
+      if (PDF < EPSILON) {
+        break;
+      }
+    }
+
+    Vec3<float> BSDF = mtl.bsdf(V, N, L, UV, res.footprint);
+    float NdotL = ::fabsf(dot(N, L));
+    beta = beta * BSDF * (NdotL / PDF);
+
+    prevP = P;
+    prevN = N;
+    prevPdf = PDF;
+    prevSpecular = specular;
+    // continue the ray cone, flat triangles keep its spread
+    ray = Ray(P, L, ray.getWidthAt(res.distance), ray.getSpread());
+  }
+
+  return radiance;
+}
+
+float Tracer::powerHeuristic(float pdfA, float pdfB) {
+  float a = pdfA * pdfA, b = pdfB * pdfB;
+  if (a + b <= 0.f) {
+    return 0.f;
+  }
+  return a / (a + b);
+}
+
 void Tracer::print() const {
-  std::cout << "Path Tracer Info:\n"
+  *log << "Path Tracer Info:\n"
   << "----------------------\n"
   << "Camera " << camera.getHeight() << 'x' << camera.getWidth() << ' '
                << camera.getEye() << ' ' << camera.getLookAt() << ' ' << camera.getLookAt() << '\n'
-  << "Scene " << scene->getSize() << ' ' << scene->getNodeCount() << '\n';
-}
-
-void Tracer::showProgress(float percent) {
-  const int barWidth = 50;
-  std::cout << "[";
-  int pos = static_cast<int>(barWidth * percent / 100.0f);
-  for (int i = 0; i < barWidth; ++i) {
-    if (i < pos) std::cout << "=";
-    else if (i == pos) std::cout << ">";
-    else std::cout << " ";
-  }
-  std::cout << "] " << std::setw(5) << std::fixed << std::setprecision(2) << percent << "%";
-  if (percent >= 100.0f) {
-    std::cout << "\n";
-  } else {
-    std::cout << '\r';
-    std::cout.flush();
+  << "Scene " << scene->getSize() << ' ' << scene->getNodeCount() << '\n'
+  << "Light " << light.getSize() << ' ' << (light.getSampling() == LIGHT_SAMPLE_BVH ? "bvh" : "power") << '\n'
+  << "Texture " << Texture::getCount() << ' ' << textureLoadTime << "s\n"
+  << "Render " << (threads ? threads : std::thread::hardware_concurrency()) << " threads, "
+               << tileSize << 'x' << tileSize << " tiles";
+  if (timeBudget > 0.f) {
+    *log << ", " << timeBudget << "s budget";
+  }
+  *log << '\n';
+  if (!cameraPath.empty()) {
+    *log << "Animation frames " << cameraPath.getFirstFrame() << '-' << cameraPath.getLastFrame() << '\n';
   }
 }
 
@@ -1,27 +1,29 @@
 #include "Triangle.hpp"
-#include "Material.hpp"
 
 #include <cassert>
+#include <cfloat>
 
 namespace spt {
 
-Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, const Material& _m)
+Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, uint _mtlId)
     : Hittable(id),
       v1(_v1),
       v2(_v2),
       v3(_v3),
       normal(normalize(cross(_v2 - _v1, _v3 - _v1))),
-      material(_m) {}
+      mtlId(_mtlId),
+      uvScale(0.f) {}
 
-Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, const Vec3<float>& _n, const Material& _m)
+Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, const Vec3<float>& _n, uint _mtlId)
     : Hittable(id),
       v1(_v1),
       v2(_v2),
       v3(_v3),
       normal(normalize(_n)),
-      material(_m) {}
+      mtlId(_mtlId),
+      uvScale(0.f) {}
 
-Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, const Vec2<float>& _vt1, const Vec2<float>& _vt2, const Vec2<float>& _vt3, const Vec3<float>& _n, const Material& _m)
+Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, const Vec3<float>& _v3, const Vec2<float>& _vt1, const Vec2<float>& _vt2, const Vec2<float>& _vt3, const Vec3<float>& _n, uint _mtlId)
     : Hittable(id),
       v1(_v1),
       v2(_v2),
@@ -30,7 +32,19 @@ Triangle::Triangle(size_t id, const Vec3<float>& _v1, const Vec3<float>& _v2, co
       vt2(_vt2),
       vt3(_vt3),
       normal(normalize(_n)),
-      material(_m) {}
+      mtlId(_mtlId) {
+  // texture lod term of the triangle, constant over its surface
+  Vec2<float> t1 = vt2 - vt1, t2 = vt3 - vt1;
+  float uvArea = ::fabsf(t1.u * t2.v - t1.v * t2.u);
+  float area = cross(v2 - v1, v3 - v1).length();
+  uvScale = area < EPSILON ? 0.f : ::sqrtf(uvArea / area);
+}
+
+// the normal is stored normalized, so it is taken as is
+Triangle::Triangle(size_t id, const TriangleRecord& record)
+    : Triangle(id, record.v[0], record.v[1], record.v[2], record.vt[0], record.vt[1], record.vt[2], record.normal, record.mtlId) {
+  normal = record.normal;
+}
 
 Triangle::~Triangle() {}
 
@@ -51,8 +65,9 @@ Vec3<float> Triangle::getMaxXYZ() const {
 }
 
 Vec3<float> Triangle::getRandomPoint() const {
+  // uniform over the area, so that pdf = 1 / area holds
   Vec3<float> e1 = v2 - v1, e2 = v3 - v2;
-  float a = sqrtf(rand(1.f)), b = sqrtf(rand(1.f));
+  float a = sqrtf(rand(1.f)), b = rand(1.f);
   return e1 * a + e2 * a * b + v1;
 }
 
@@ -85,7 +100,13 @@ Vec2<float> Triangle::getTexCoord(const Vec3<float>& coord) const {
   return texCoord;
 }
 
-Material Triangle::getMaterial() const { return material; }
+Vec3<float> Triangle::getNormal() const { return normal; }
+
+uint Triangle::getMaterialId() const { return mtlId; }
+
+TriangleRecord Triangle::getRecord() const {
+  return {{v1, v2, v3}, {vt1, vt2, vt3}, normal, mtlId};
+}
 
 float Triangle::getSize() const {
   return cross(v2 - v1, v3 - v1).length() / 2;
@@ -113,33 +134,46 @@ bool Triangle::contain(const Vec3<float>& p) const {
   return u >= 0 && v >= 0 && u+v <= 1;
 }
 
-void Triangle::hit(const Ray& ray, HitResult& res) const {
-  Vec3<float> origin = ray.getOrigin();
-  Vec3<float> direction = ray.getDirection();
+// plane hit inside the triangle between the self-intersection offset and tMax
+bool Triangle::intersect(const Ray& ray, float tMax, float& t, float& denom) const {
+  denom = dot(normal, ray.getDirection());
+  // ray is parallel to triangle face
+  if (fabs(denom) <= EPSILON) {
+    return false;
+  }
 
+  t = (dot(normal, v1) - dot(normal, ray.getOrigin()))/denom;
+  if (t < RAY_OFFSET || t >= tMax) {
+    return false;
+  }
+  return contain(ray.getPointAt(t));
+}
+
+void Triangle::hit(const Ray& ray, HitResult& res) const {
   // initialize hit result
   res.hit = false;
   res.id = this->getId();
 
-  float denom = dot(normal, direction);
-  // ray is parallel to triangle face
-  if (fabs(denom) <= EPSILON) {
+  float t, denom;
+  if (!intersect(ray, FLT_MAX, t, denom)) {
     return;
   }
 
-  float t = (dot(normal, v1) - dot(normal, origin))/denom;
   Vec3<float> p = ray.getPointAt(t);
-  if (t < 0.05 || !contain(p)) {
-    return;
-  }
-
   res.hit = true;
   res.point = p;
   res.uv = getTexCoord(p);
   res.distance = t;
   res.normal = normal;
-  res.material = material;
+  res.mtlId = mtlId;
+  // cone footprint projected onto the surface
+  res.footprint = ray.getWidthAt(t) / ::fabsf(denom) * uvScale;
   return;
 }
 
+bool Triangle::occluded(const Ray& ray, float tMax) const {
+  float t, denom;
+  return intersect(ray, tMax, t, denom);
+}
+
 }  // namespace spt
@@ -0,0 +1,100 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Material.hpp"
+
+#include <tiny_obj_loader.h>
+
+using namespace spt;
+
+static void usage() {
+  std::cout << "usage: bsdfbench [calls]\n"
+            << "evaluates bsdf, batched bsdf and scatter over every surface, illumination model and\n"
+            << "transmission variant on one thread, prints calls per second and a checksum of the results\n";
+}
+
+// every kernel variant: diffuse, glossy and specular surfaces under each model, opaque and transmissive
+static std::vector<Material> variants() {
+  std::vector<Material> materials;
+  for (uint illu : {BSDF_MICROFACET, BSDF_PHONG, BSDF_BLINN_PHONG}) {
+    for (float roughness : {1.f, 0.5f, 0.005f}) {
+      for (float dissolve : {1.f, 0.5f}) {
+        tinyobj::material_t mtl;
+        for (int c = 0; c < 3; c++) {
+          mtl.diffuse[c] = 0.8f;
+          mtl.specular[c] = 0.2f;
+        }
+        mtl.metallic = 0.3f;
+        mtl.roughness = roughness;
+        mtl.shininess = 50.f;
+        mtl.dissolve = dissolve;
+        mtl.ior = 1.5f;
+        materials.emplace_back(mtl, "", illu);
+      }
+    }
+  }
+  return materials;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 2) {
+    usage();
+    return 1;
+  }
+  size_t calls = (argc == 2) ? std::stoul(argv[1]) : 400000;
+
+  // inputs drawn up front so only the kernels are timed
+  std::mt19937 rng(1);
+  std::uniform_real_distribution<float> u(-1.f, 1.f);
+  auto direction = [&]() { return normalize(Vec3<float>(u(rng), u(rng), u(rng))); };
+  const size_t inputCount = 1024;
+  std::vector<Vec3<float>> Vs(inputCount), Ls(inputCount);
+  for (size_t i = 0; i < inputCount; i++) {
+    Vs[i] = direction();
+    Ls[i] = direction();
+  }
+  Vec3<float> N(0.f, 1.f, 0.f);
+  Vec2<float> UV(0.5f, 0.5f);
+
+  std::vector<Material> materials = variants();
+  size_t perMaterial = calls / materials.size() / 8 * 8;
+
+  // run evaluates lanes directions per call, starting at input i
+  auto time = [&](const char* name, size_t lanes, auto run) {
+    double sum = 0.0;
+    auto start = std::chrono::steady_clock::now();
+    for (const Material& mtl : materials) {
+      for (size_t i = 0; i < perMaterial; i += lanes) {
+        sum += run(mtl, i % inputCount);
+      }
+    }
+    float seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+    std::cout << name << ": " << perMaterial * materials.size() / seconds / 1e6f << " M/s, checksum " << sum << "\n";
+  };
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << materials.size() << " variants, " << perMaterial * materials.size() << " evaluations\n";
+  time("bsdf", 1, [&](const Material& mtl, size_t i) {
+    Vec3<float> f = mtl.bsdf(Vs[i], N, Ls[i], UV);
+    return double(f.x + f.y + f.z);
+  });
+  time("bsdf x8", 8, [&](const Material& mtl, size_t i) {
+    Vec3<float> f[8];
+    mtl.bsdf(Vs[i], N, &Ls[i], 8, UV, f);
+    double sum = 0.0;
+    for (const auto& v : f) {
+      sum += v.x + v.y + v.z;
+    }
+    return sum;
+  });
+  // scatter draws from the thread's random stream, so its checksum varies between runs
+  time("scatter", 1, [&](const Material& mtl, size_t i) {
+    auto [L, pdf] = mtl.scatter(Vs[i], N);
+    return double(pdf);
+  });
+  return 0;
+}
@@ -0,0 +1,96 @@
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <string>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+static void usage() {
+  std::cout << "usage: client <socket> [jobs.jsonl]\n"
+            << "sends one render job per line (stdin without a file) to a server started with\n"
+            << "main --serve <socket> and prints a reply per job, e.g.\n"
+            << "  {\"scene\": \"../example/cornell-box/\", \"models\": [\"cornell-box.obj\"], \"config\": \"cornell-box.xml\",\n"
+            << "   \"output\": \"preview.png\", \"spp\": 4, \"camera\": {\"eye\": [278, 273, -600]}}\n"
+            << "  {\"command\": \"quit\"}\n";
+}
+
+static bool sendAll(int fd, const std::string& data) {
+  for (size_t sent = 0; sent < data.size();) {
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent, MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) {
+      continue;
+    }
+    if (n <= 0) {
+      return false;
+    }
+    sent += n;
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    usage();
+    return 1;
+  }
+  std::string path = argv[1];
+
+  std::ifstream file;
+  if (argc == 3) {
+    file.open(argv[2]);
+    if (!file) {
+      std::cerr << "Error: Job file load failure (file: " << argv[2] << ")" << std::endl;
+      return 1;
+    }
+  }
+  std::istream& jobs = (argc == 3) ? file : std::cin;
+
+  sockaddr_un address;
+  memset(&address, 0, sizeof(address));
+  address.sun_family = AF_UNIX;
+  if (path.size() >= sizeof(address.sun_path)) {
+    std::cerr << "Error: Socket path too long (file: " << path << ")" << std::endl;
+    return 1;
+  }
+  strcpy(address.sun_path, path.c_str());
+  int fd = ::socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0 || ::connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) != 0) {
+    std::cerr << "Error: Server connect failure (file: " << path << ")" << std::endl;
+    return 1;
+  }
+
+  // one job at a time, so each reply follows its job
+  int failed = 0;
+  std::string line, buffer;
+  char chunk[4096];
+  while (std::getline(jobs, line)) {
+    if (line.find_first_not_of(" \t\r") == std::string::npos) {
+      continue;
+    }
+    if (!sendAll(fd, line + '\n')) {
+      std::cerr << "Error: Server connection lost" << std::endl;
+      return 1;
+    }
+    size_t end;
+    while ((end = buffer.find('\n')) == std::string::npos) {
+      ssize_t n = ::read(fd, chunk, sizeof(chunk));
+      if (n < 0 && errno == EINTR) {
+        continue;
+      }
+      if (n <= 0) {
+        std::cerr << "Error: Server connection lost" << std::endl;
+        return 1;
+      }
+      buffer.append(chunk, n);
+    }
+    std::string reply = buffer.substr(0, end);
+    buffer.erase(0, end + 1);
+    std::cout << reply << std::endl;
+    failed += reply.find("\"ok\":false") != std::string::npos;
+  }
+
+  ::close(fd);
+  return failed > 0 ? 1 : 0;
+}
@@ -0,0 +1,131 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Light.hpp"
+
+using namespace spt;
+
+static void usage() {
+  std::cout << "usage: lightbench [spp] [points]\n"
+            << "estimates direct light on a floor under 3 to 10k scattered emissive triangles with the\n"
+            << "power sampler and with the light bvh (<lightsampler type=\"bvh\"/>), prints the time per\n"
+            << "sample, the relative variance of one sample and the efficiency of the bvh over the power sampler\n";
+}
+
+// per sampler result over all points
+struct Result {
+  float seconds = 0.f;
+  double variance = 0.0; // mean over the points of variance / mean^2 of one sample
+};
+
+// lights of four groups with different emission, spread over a 100 x 100 area at height 8 to 12,
+// above a floor of two triangles; object ids follow their order in objects
+static void buildScene(size_t count, std::vector<std::shared_ptr<Hittable>>& objects,
+                       std::vector<std::shared_ptr<Triangle>>& lights, std::vector<Vec3<float>>& emissions,
+                       std::vector<std::string>& names) {
+  std::mt19937 rng(7);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  const Vec3<float> groupEmission[4] = {{20.f, 20.f, 20.f}, {5.f, 4.f, 3.f}, {1.f, 2.f, 4.f}, {50.f, 45.f, 40.f}};
+
+  for (size_t i = 0; i < count; i++) {
+    Vec3<float> p(u(rng) * 100 - 50, 8 + u(rng) * 4, u(rng) * 100 - 50);
+    float size = 0.2f + u(rng);
+    Vec3<float> a(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f), b(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f);
+    auto triangle = std::make_shared<Triangle>(objects.size(), p, p + a * size, p + b * size, 0u);
+    objects.push_back(triangle);
+    lights.push_back(triangle);
+    emissions.push_back(groupEmission[i % 4]);
+    names.push_back("light" + std::to_string(i % 4));
+  }
+
+  Vec3<float> c0(-60.f, 0.f, -60.f), c1(60.f, 0.f, -60.f), c2(60.f, 0.f, 60.f), c3(-60.f, 0.f, 60.f);
+  objects.push_back(std::make_shared<Triangle>(objects.size(), c0, c2, c1, 0u));
+  objects.push_back(std::make_shared<Triangle>(objects.size(), c0, c3, c2, 0u));
+}
+
+// spp one-sample estimates of the irradiance luminance at each point
+static Result measure(LightSampling sampling, const std::shared_ptr<BVH>& scene,
+                      const std::vector<std::shared_ptr<Triangle>>& lights, const std::vector<Vec3<float>>& emissions,
+                      const std::vector<std::string>& names, const std::vector<Vec3<float>>& points, size_t spp) {
+  Light light;
+  light.setSampling(sampling);
+  for (size_t i = 0; i < lights.size(); i++) {
+    light.setLight(lights[i], emissions[i], names[i]);
+  }
+  light.build();
+
+  // the same random stream for both samplers
+  seedRand(1);
+  Vec3<float> N(0.f, 1.f, 0.f);
+  Result result;
+  auto start = std::chrono::steady_clock::now();
+  for (const Vec3<float>& p : points) {
+    double sum = 0.0, sumSq = 0.0;
+    for (size_t s = 0; s < spp; s++) {
+      LightSample ls = light.sampleLi(scene, p, N);
+      double value = 0.0;
+      if (ls.pdf > 0.f) {
+        value = luminance(ls.emission) * std::max(0.f, dot(N, ls.dir)) / ls.pdf;
+      }
+      sum += value;
+      sumSq += value * value;
+    }
+    double mean = sum / spp;
+    if (mean > 0.0) {
+      result.variance += (sumSq / spp - mean * mean) / (mean * mean) / points.size();
+    }
+  }
+  result.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  return result;
+}
+
+int main(int argc, char** argv) {
+  if (argc > 3) {
+    usage();
+    return 1;
+  }
+  size_t spp = (argc >= 2) ? std::stoul(argv[1]) : 256;
+  size_t pointCount = (argc == 3) ? std::stoul(argv[2]) : 256;
+  if (spp < 2 || pointCount == 0) {
+    usage();
+    return 1;
+  }
+
+  // receivers on the floor below the lights
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> u(-45.f, 45.f);
+  std::vector<Vec3<float>> points(pointCount);
+  for (auto& p : points) {
+    p = Vec3<float>(u(rng), 0.f, u(rng));
+  }
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << spp << " spp at " << pointCount << " points, one thread\n";
+  std::cout << std::setw(8) << "lights" << std::setw(14) << "power us/spp" << std::setw(14) << "power var"
+            << std::setw(14) << "bvh us/spp" << std::setw(14) << "bvh var" << std::setw(14) << "efficiency" << "\n";
+  for (size_t count : {3, 10, 100, 1000, 10000}) {
+    std::vector<std::shared_ptr<Hittable>> objects;
+    std::vector<std::shared_ptr<Triangle>> lights;
+    std::vector<Vec3<float>> emissions;
+    std::vector<std::string> names;
+    buildScene(count, objects, lights, emissions, names);
+    auto scene = BVH::constructBVH(objects, 0, int(objects.size()));
+
+    Result power = measure(LIGHT_SAMPLE_POWER, scene, lights, emissions, names, points, spp);
+    Result bvh = measure(LIGHT_SAMPLE_BVH, scene, lights, emissions, names, points, spp);
+
+    // inverse of variance times time, relative to the power sampler
+    double samples = double(spp) * pointCount;
+    double efficiency = (power.variance * power.seconds) / std::max(1e-30, bvh.variance * bvh.seconds);
+    std::cout << std::setw(8) << count << std::setw(14) << power.seconds / samples * 1e6 << std::setw(14) << power.variance
+              << std::setw(14) << bvh.seconds / samples * 1e6 << std::setw(14) << bvh.variance << std::setw(13)
+              << efficiency << "x\n";
+  }
+  return 0;
+}
@@ -1,29 +1,239 @@
-#include <ctime>
+#include <chrono>
+#include <climits>
+#include <cstdio>
 #include <iostream>
+#include <thread>
 
+#include "Server.hpp"
 #include "Trace.hpp"
 
 using namespace spt;
 
-int main() {
-  srand(time(nullptr));
-  char windName[] = "simple render engine";
+static void usage() {
+  std::cout << "usage: main [options] <dir> <model.obj>... <config.xml>\n"
+            << "       main [options] <scene.sptc>   a scene compiled by sptc\n"
+            << "options override the scene config:\n"
+            << "  -t, --threads N   worker threads, 0 uses all cores (default 0)\n"
+            << "  --tile N          tile size in pixels (default 32)\n"
+            << "  --order O         tile order: hilbert, spiral or scanline (default hilbert)\n"
+            << "  --spp N           samples per pixel (default 4)\n"
+            << "  --depth N         max path depth (default 3)\n"
+            << "  -o FILE           output image, .pfm or .exr write linear float, .sptf a partial for merge (default result.png)\n"
+            << "  --pass N          samples per progressive pass (default 1)\n"
+            << "  --checkpoint FILE resume from and periodically save to FILE\n"
+            << "  --interval S      seconds between checkpoints (default 300)\n"
+            << "  --adaptive T      stop sampling pixels below relative error T, spp is the cap\n"
+            << "  --minspp N        base spp before adaptive sampling (default 16)\n"
+            << "  --budget S        render passes until S seconds have passed, spp is ignored\n"
+            << "  --denoise N       a-trous denoiser with N iterations, 0 disables (default 0)\n"
+            << "  --crop X0,Y0,X1,Y1 render only this window of the frame\n"
+            << "  --range A:B       render sample indices [A, B) per pixel instead of --spp\n"
+            << "  --seed S          base of the per-pixel random streams (default 0)\n"
+            << "  --animation FILE  camera keyframes (an <animation> element), renders the sequence\n"
+            << "  --frames A:B      render only frames A to B of the animation\n"
+            << "  --serve SOCKET    keep scenes loaded and render JSON jobs from a unix socket, - reads stdin\n"
+            << "  -q, --quiet       no progress bar\n"
+            << "  --scaling         render with 1, 2, 4 ... N threads and report the speedup\n";
+}
+
+int main(int argc, char** argv) {
   int depth = 3;
   int spp = 4;
   float threshold = 0.8;
+  std::string output = "result.png";
+  bool scaling = false;
+  bool quiet = false;
+
+  // negative means not given, keep the scene config
+  int threads = -1;
+  int tileSize = -1;
+  int order = -1;
+  int passSamples = -1;
+  std::string checkpoint;
+  float interval = 300.f;
+  float adaptive = -1.f;
+  int minSamples = 16;
+  float budget = -1.f;
+  int denoise = -1;
+  Tile crop = {0, 0, 0, 0};
+  int rangeBegin = -1, rangeEnd = -1;
+  uint64_t seed = 0;
+  std::string animation;
+  int firstFrame = INT_MIN, lastFrame = INT_MAX;
+  bool outputGiven = false;
+  std::string serve;
+
+  // scene
+  std::string dir = "../example/metal-box/";
+  std::vector<std::string> models = {"floor.obj", "light.obj", "left.obj", "right.obj", "shortbox.obj", "tallbox.obj"};
+  std::string config = "cornell-box.xml";
+
+  std::vector<std::string> positional;
+  for (int i = 1; i < argc; i++) {
+    std::string arg = argv[i];
+    bool hasValue = i + 1 < argc;
+    if ((arg == "-t" || arg == "--threads") && hasValue) {
+      threads = std::stoi(argv[++i]);
+    } else if (arg == "--tile" && hasValue) {
+      tileSize = std::stoi(argv[++i]);
+    } else if (arg == "--order" && hasValue) {
+      std::string o = argv[++i];
+      order = (o == "spiral") ? TILE_ORDER_SPIRAL : (o == "scanline") ? TILE_ORDER_SCANLINE : TILE_ORDER_HILBERT;
+    } else if (arg == "--spp" && hasValue) {
+      spp = std::stoi(argv[++i]);
+    } else if (arg == "--depth" && hasValue) {
+      depth = std::stoi(argv[++i]);
+    } else if (arg == "-o" && hasValue) {
+      output = argv[++i];
+      outputGiven = true;
+    } else if (arg == "--pass" && hasValue) {
+      passSamples = std::stoi(argv[++i]);
+    } else if (arg == "--checkpoint" && hasValue) {
+      checkpoint = argv[++i];
+    } else if (arg == "--interval" && hasValue) {
+      interval = std::stof(argv[++i]);
+    } else if (arg == "--adaptive" && hasValue) {
+      adaptive = std::stof(argv[++i]);
+    } else if (arg == "--minspp" && hasValue) {
+      minSamples = std::stoi(argv[++i]);
+    } else if (arg == "--budget" && hasValue) {
+      budget = std::stof(argv[++i]);
+    } else if (arg == "--denoise" && hasValue) {
+      denoise = std::stoi(argv[++i]);
+    } else if (arg == "--crop" && hasValue) {
+      if (std::sscanf(argv[++i], "%d,%d,%d,%d", &crop.x0, &crop.y0, &crop.x1, &crop.y1) != 4) {
+        usage();
+        return 1;
+      }
+    } else if (arg == "--range" && hasValue) {
+      if (std::sscanf(argv[++i], "%d:%d", &rangeBegin, &rangeEnd) != 2 || rangeBegin < 0 || rangeEnd <= rangeBegin) {
+        usage();
+        return 1;
+      }
+      spp = rangeEnd - rangeBegin;
+    } else if (arg == "--seed" && hasValue) {
+      seed = std::stoull(argv[++i]);
+    } else if (arg == "--animation" && hasValue) {
+      animation = argv[++i];
+    } else if (arg == "--frames" && hasValue) {
+      if (std::sscanf(argv[++i], "%d:%d", &firstFrame, &lastFrame) != 2) {
+        usage();
+        return 1;
+      }
+    } else if (arg == "--serve" && hasValue) {
+      serve = argv[++i];
+    } else if (arg == "-q" || arg == "--quiet") {
+      quiet = true;
+    } else if (arg == "--scaling") {
+      scaling = true;
+    } else if (arg == "-h" || arg == "--help") {
+      usage();
+      return 0;
+    } else {
+      positional.push_back(arg);
+    }
+  }
+
+  // server mode, scenes come with the jobs
+  if (!serve.empty()) {
+    RenderServer server(std::max(threads, 0), depth, spp, threshold);
+    if (serve == "-") {
+      server.serveStdin();
+      return 0;
+    }
+    return server.serveSocket(serve) ? 0 : 1;
+  }
+
+  std::string compiled;
+  if (positional.size() == 1 && positional[0].size() > 5 && positional[0].compare(positional[0].size() - 5, 5, ".sptc") == 0) {
+    compiled = positional[0];
+  } else if (positional.size() >= 3) {
+    dir = positional.front();
+    config = positional.back();
+    models.assign(positional.begin() + 1, positional.end() - 1);
+  } else if (!positional.empty()) {
+    usage();
+    return 1;
+  }
+
   Tracer tracer(depth, spp, threshold);
+  if (!compiled.empty()) {
+    if (!tracer.loadCompiled(compiled)) {
+      return 1;
+    }
+  } else {
+    tracer.load(dir, models, config);
+  }
+  tracer.setQuiet(quiet);
+  tracer.setCrop(crop);
+  tracer.setSeed(seed);
+  if (rangeBegin >= 0) {
+    tracer.setSampleOffset(rangeBegin);
+  }
+  if (tileSize > 0) {
+    tracer.setTileSize(tileSize);
+  }
+  if (order >= 0) {
+    tracer.setTileOrder(TileOrder(order));
+  }
+  if (passSamples >= 0) {
+    tracer.setPassSamples(passSamples);
+  }
+  if (!checkpoint.empty()) {
+    tracer.setCheckpoint(checkpoint, interval);
+  }
+  if (budget >= 0.f) {
+    tracer.setTimeBudget(budget);
+  }
+  if (denoise >= 0) {
+    tracer.setDenoise(denoise);
+  }
+  if (adaptive >= 0.f) {
+    tracer.setAdaptive(adaptive, minSamples);
+  }
+
+  if (!animation.empty() && !tracer.loadAnimation(animation)) {
+    std::cerr << "Error: Animation load failure (file: " << animation << ")" << std::endl;
+    return 1;
+  }
+
+  // animation, the scene stays loaded and frames render back to back
+  if (tracer.hasAnimation() && !scaling) {
+    if (threads >= 0) {
+      tracer.setThreads(threads);
+    }
+    tracer.renderSequence(outputGiven ? output : "", firstFrame, lastFrame);
+    return 0;
+  }
+
+  auto renderTimed = [&](int n) {
+    if (n >= 0) {
+      tracer.setThreads(n);
+    }
+    auto start = std::chrono::steady_clock::now();
+    tracer.render(output);
+    return std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+  };
 
-  // tracer.load("../example/veach-mis/", {"veach-mis.obj"}, "veach-mis.xml");
-  // tracer.load("../example/staircase/", {"stairscase.obj"}, "staircase.xml");
-  // tracer.load("../example/cornell-box/", {"cornell-box.obj"}, "cornell-box.xml");
-  // tracer.load("../example/box/", {"floor.obj", "light.obj", "left.obj", "right.obj", "shortbox.obj", "tallbox.obj"}, "cornell-box.xml");
-  tracer.load("../example/metal-box/", {"floor.obj", "light.obj", "left.obj", "right.obj", "shortbox.obj", "tallbox.obj"}, "cornell-box.xml");
+  if (!scaling) {
+    std::cout << "Rendering time: " << renderTimed(threads) << "s" << std::endl;
+    return 0;
+  }
 
-  // render
-  time_t start = time(0);
-  tracer.render();
-  time_t end = time(0);
-  std::cout << "Rendering time: " << difftime(end, start) << "s" << std::endl;
+  // scaling benchmark, 1 to N threads
+  int maxThreads = threads > 0 ? threads : std::max(1u, std::thread::hardware_concurrency());
+  double base = 0.0;
+  std::cout << "threads\ttime(s)\tspeedup\tefficiency\n";
+  for (int n = 1;; n = std::min(n * 2, maxThreads)) {
+    double t = renderTimed(n);
+    if (n == 1) {
+      base = t;
+    }
+    std::cout << n << '\t' << t << '\t' << base / t << '\t' << base / t / n << std::endl;
+    if (n == maxThreads) {
+      break;
+    }
+  }
 
   return 0;
-}
\ No newline at end of file
+}
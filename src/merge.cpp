@@ -0,0 +1,77 @@
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Film.hpp"
+#include "ImageWriter.hpp"
+
+#include <stb_image_write.h>
+
+using namespace spt;
+
+static void usage() {
+  std::cout << "usage: merge <output> <partial.sptf>...\n"
+            << "adds up the partials of a distributed render, crop windows and sample ranges alike;\n"
+            << "the output format follows its extension: .png, .pfm, .exr or .sptf for a further merge\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 3) {
+    usage();
+    return 1;
+  }
+  std::string output = argv[1];
+
+  // the frame comes from the first partial
+  Film frame;
+  for (int i = 2; i < argc; i++) {
+    Film part;
+    if (!part.loadPartial(argv[i])) {
+      std::cerr << "Error: Partial load failure (file: " << argv[i] << ")" << std::endl;
+      return 1;
+    }
+    if (i == 2) {
+      frame = Film(part.getFrameWidth(), part.getFrameHeight());
+    }
+    if (!frame.merge(part)) {
+      std::cerr << "Error: Partial of a different frame (file: " << argv[i] << ")" << std::endl;
+      return 1;
+    }
+  }
+
+  // pixels no partial covered stay black
+  int w = frame.getWidth(), h = frame.getHeight();
+  int uncovered = 0;
+  for (int row = 0; row < h; row++) {
+    for (int col = 0; col < w; col++) {
+      uncovered += frame.getCount(row, col) == 0;
+    }
+  }
+  std::cout << "Merged " << argc - 2 << " partials, " << double(frame.getTotalCount()) / (w * h) << " spp on average";
+  if (uncovered > 0) {
+    std::cout << ", " << uncovered << " pixels without samples";
+  }
+  std::cout << '\n';
+
+  bool ok = true;
+  ImageFormat format = ImageWriter::getFormat(output);
+  if (format == IMAGE_FILM) {
+    ok = frame.save(output);
+  } else if (format == IMAGE_PNG) {
+    std::vector<uint8_t> img = frame.toImage();
+    ok = stbi_write_png(output.c_str(), w, h, 3, img.data(), w * 3) != 0;
+  } else {
+    ImageWriter writer;
+    std::vector<Vec3<float>> image = frame.getImage();
+    ok = writer.open(output, w, h, format);
+    for (int row = 0; row < h && ok; row++) {
+      ok = writer.writeRow(row, 0, &image[row * w], w);
+    }
+    ok = writer.close() && ok;
+  }
+  if (!ok) {
+    std::cerr << "Error: Image write failure (file: " << output << ")" << std::endl;
+    return 1;
+  }
+  return 0;
+}
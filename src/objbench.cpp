@@ -0,0 +1,102 @@
+#include <chrono>
+#include <iomanip>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "ObjParser.hpp"
+#include "ThreadPool.hpp"
+
+#include <tiny_obj_loader.h>
+
+using namespace spt;
+
+static void usage() {
+  std::cout << "usage: objbench <model.obj> [threads]\n"
+            << "loads the model with tinyobj and with the chunked parser, prints the time and\n"
+            << "throughput of each and whether both return the same attributes and faces\n";
+}
+
+struct Model {
+  tinyobj::attrib_t attrib;
+  std::vector<tinyobj::shape_t> shapes;
+  std::vector<tinyobj::material_t> materials;
+  std::string warn, err;
+  bool ok = false;
+  float seconds = 0.f;
+};
+
+static bool sameIndex(const tinyobj::index_t& a, const tinyobj::index_t& b) {
+  return a.vertex_index == b.vertex_index && a.texcoord_index == b.texcoord_index && a.normal_index == b.normal_index;
+}
+
+// shapes may be cut differently, so faces are compared as one sequence
+static bool same(const Model& a, const Model& b) {
+  if (a.attrib.vertices != b.attrib.vertices || a.attrib.texcoords != b.attrib.texcoords ||
+      a.attrib.normals != b.attrib.normals || a.materials.size() != b.materials.size()) {
+    return false;
+  }
+  std::vector<tinyobj::index_t> indices[2];
+  std::vector<int> materialIds[2];
+  const Model* models[2] = {&a, &b};
+  for (int m = 0; m < 2; m++) {
+    for (const auto& shape : models[m]->shapes) {
+      indices[m].insert(indices[m].end(), shape.mesh.indices.begin(), shape.mesh.indices.end());
+      materialIds[m].insert(materialIds[m].end(), shape.mesh.material_ids.begin(), shape.mesh.material_ids.end());
+    }
+  }
+  if (indices[0].size() != indices[1].size() || materialIds[0] != materialIds[1]) {
+    return false;
+  }
+  for (size_t i = 0; i < indices[0].size(); i++) {
+    if (!sameIndex(indices[0][i], indices[1][i])) {
+      return false;
+    }
+  }
+  return true;
+}
+
+int main(int argc, char** argv) {
+  if (argc < 2 || argc > 3) {
+    usage();
+    return 1;
+  }
+  std::string file = argv[1];
+  std::string dir = file.substr(0, file.find_last_of('/') + 1);
+  size_t threads = (argc == 3) ? std::stoul(argv[2]) : 0;
+  ThreadPool pool(threads);
+
+  ObjParser probe;
+  if (!probe.open(file)) {
+    std::cerr << "Error: Model load failure (file: " << file << ")" << std::endl;
+    return 1;
+  }
+  float megabytes = probe.getFileSize() / 1e6f;
+
+  auto time = [](Model& model, auto load) {
+    auto start = std::chrono::steady_clock::now();
+    model.ok = load(model);
+    model.seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  };
+  Model reference, chunked;
+  time(reference, [&](Model& m) {
+    return tinyobj::LoadObj(&m.attrib, &m.shapes, &m.materials, &m.warn, &m.err, file.c_str(), dir.c_str());
+  });
+  time(chunked, [&](Model& m) {
+    return ObjParser::load(file, dir, pool, m.attrib, m.shapes, m.materials, m.warn, m.err);
+  });
+
+  std::cout << std::fixed << std::setprecision(3);
+  std::cout << "file: " << megabytes << "MB, " << probe.getChunkCount() << " chunks, " << pool.size() << " threads\n";
+  for (const auto& [name, model] : {std::make_pair("tinyobj", &reference), std::make_pair("chunked", &chunked)}) {
+    std::cout << name << ": " << (model->ok ? "" : "failed, ") << model->seconds << "s, "
+              << megabytes / model->seconds << "MB/s, " << model->attrib.vertices.size() / 3 << " vertices, "
+              << model->shapes.size() << " shapes\n";
+    if (!model->err.empty()) {
+      std::cerr << model->err;
+    }
+  }
+  bool match = reference.ok && chunked.ok && same(reference, chunked);
+  std::cout << "speedup: " << reference.seconds / chunked.seconds << "x, results " << (match ? "match" : "differ") << std::endl;
+  return match ? 0 : 1;
+}
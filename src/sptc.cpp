@@ -0,0 +1,54 @@
+#include <chrono>
+#include <iostream>
+#include <string>
+#include <vector>
+
+#include "Trace.hpp"
+
+using namespace spt;
+
+static void usage() {
+  std::cout << "usage: sptc <dir> <model.obj>... <config.xml> <output.sptc>\n"
+            << "compiles a scene into one binary file holding its triangles, bvh, materials, lights\n"
+            << "and config; main renders it without parsing, e.g.\n"
+            << "  sptc ../example/veach-mis/ veach-mis.obj veach-mis.xml ../example/veach-mis/veach-mis.sptc\n"
+            << "  main ../example/veach-mis/veach-mis.sptc\n"
+            << "textures stay separate files, found relative to the output\n";
+}
+
+int main(int argc, char** argv) {
+  if (argc < 5) {
+    usage();
+    return 1;
+  }
+  std::string dir = argv[1];
+  std::vector<std::string> models(argv + 2, argv + argc - 2);
+  std::string config = argv[argc - 2];
+  std::string output = argv[argc - 1];
+
+  Tracer tracer;
+  auto start = std::chrono::steady_clock::now();
+  if (!tracer.load(dir, models, config)) {
+    return 1;
+  }
+  float loadTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+  start = std::chrono::steady_clock::now();
+  if (!tracer.saveCompiled(output)) {
+    std::cerr << "Error: Compiled scene save failure (file: " << output << ")" << std::endl;
+    return 1;
+  }
+  float saveTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Compiled " << output << ": text load " << loadTime << "s, write " << saveTime << "s" << std::endl;
+
+  // read back, so the numbers of both paths are printed side by side
+  Tracer compiled;
+  compiled.setQuiet(true);
+  start = std::chrono::steady_clock::now();
+  if (!compiled.loadCompiled(output)) {
+    return 1;
+  }
+  float compiledTime = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+  std::cout << "Compiled load " << compiledTime << "s, " << loadTime / compiledTime << "x faster" << std::endl;
+  return 0;
+}
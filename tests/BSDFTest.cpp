@@ -0,0 +1,99 @@
+#include <cmath>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "Material.hpp"
+
+#include <tiny_obj_loader.h>
+
+using namespace spt;
+
+int main() {
+  std::mt19937 rng(3);
+  std::uniform_real_distribution<float> u(-1.f, 1.f);
+  auto direction = [&]() { return normalize(Vec3<float>(u(rng), u(rng), u(rng))); };
+
+  // every kernel variant
+  std::vector<Material> materials;
+  for (uint illu : {BSDF_MICROFACET, BSDF_PHONG, BSDF_BLINN_PHONG}) {
+    for (float roughness : {1.f, 0.5f, 0.005f}) {
+      for (float dissolve : {1.f, 0.5f}) {
+        tinyobj::material_t mtl;
+        for (int c = 0; c < 3; c++) {
+          mtl.diffuse[c] = 0.8f;
+          mtl.specular[c] = 0.2f;
+        }
+        mtl.metallic = 0.3f;
+        mtl.roughness = roughness;
+        mtl.shininess = 50.f;
+        mtl.dissolve = dissolve;
+        mtl.ior = 1.5f;
+        materials.emplace_back(mtl, "", illu);
+      }
+    }
+  }
+  materials.emplace_back();
+
+  // batched evaluation matches one direction at a time, including partial and single batches
+  Vec3<float> N(0.f, 1.f, 0.f);
+  Vec2<float> UV(0.5f, 0.5f);
+  for (const Material& mtl : materials) {
+    for (size_t count : {1, 2, 7, 8, 9, 17}) {
+      Vec3<float> V = direction();
+      std::vector<Vec3<float>> L(count), batched(count);
+      for (auto& l : L) {
+        l = direction();
+      }
+      mtl.bsdf(V, N, L.data(), count, UV, batched.data());
+      for (size_t i = 0; i < count; i++) {
+        Vec3<float> scalar = mtl.bsdf(V, N, L[i], UV);
+        float tol = 1e-4f * (1.f + scalar.x + scalar.y + scalar.z);
+        CHECK_NEAR(batched[i].x, scalar.x, tol);
+        CHECK_NEAR(batched[i].y, scalar.y, tol);
+        CHECK_NEAR(batched[i].z, scalar.z, tol);
+      }
+    }
+  }
+
+  // the sampling density of scatter() is the one pdf() reports: sample frequencies per
+  // solid angle bin against the pdf integrated over the bin, for rough glass seen from
+  // inside, where total internal reflection is common, and from outside
+  {
+    tinyobj::material_t glass;
+    for (int c = 0; c < 3; c++) {
+      glass.diffuse[c] = 0.8f;
+      glass.specular[c] = 0.2f;
+    }
+    glass.roughness = 0.5f;
+    glass.dissolve = 0.5f;
+    glass.ior = 1.5f;
+    Material mtl(glass, "", BSDF_MICROFACET);
+
+    // side of the surface and four bands of |cos|
+    auto bin = [&N](const Vec3<float>& L) {
+      float c = dot(N, L);
+      return (c > 0 ? 4 : 0) + std::min(3, int(::fabsf(c) * 4));
+    };
+    std::normal_distribution<float> g;
+    const int n = 400000;
+    for (float cosV : {-0.3f, -0.9f, 0.5f}) {
+      Vec3<float> V(::sqrtf(1 - cosV * cosV), cosV, 0.f);
+      double frequency[8] = {}, integral[8] = {};
+      for (int i = 0; i < n; i++) {
+        auto [L, PDF] = mtl.scatter(V, N);
+        if (L != Vec3(0.f, 0.f, 0.f) && PDF > 0.f) {
+          frequency[bin(normalize(L))] += 1.0 / n;
+        }
+        // uniform directions over the sphere
+        Vec3<float> U = normalize(Vec3<float>(g(rng), g(rng), g(rng)));
+        integral[bin(U)] += mtl.pdf(V, N, U) * 4 * PI / n;
+      }
+      for (int b = 0; b < 8; b++) {
+        CHECK_NEAR(frequency[b], integral[b], 0.004 + 0.03 * integral[b]);
+      }
+    }
+  }
+
+  return checkFailures == 0 ? 0 : 1;
+}
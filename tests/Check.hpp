@@ -0,0 +1,21 @@
+#ifndef SRE_CHECK_HPP
+#define SRE_CHECK_HPP
+
+#include <cmath>
+#include <iostream>
+
+// minimal checks for the regression tests, a test exits non-zero if any failed
+static int checkFailures = 0;
+
+#define CHECK(cond)                                                                              \
+  do {                                                                                           \
+    if (!(cond)) {                                                                               \
+      std::cerr << "Error: Check failure (" << #cond << ", " << __FILE__ << ":" << __LINE__ << ")" \
+                << std::endl;                                                                    \
+      checkFailures++;                                                                           \
+    }                                                                                            \
+  } while (0)
+
+#define CHECK_NEAR(a, b, tol) CHECK(std::fabs(double(a) - double(b)) <= double(tol))
+
+#endif
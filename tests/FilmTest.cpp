@@ -0,0 +1,85 @@
+#include <cstdio>
+#include <fstream>
+#include <random>
+#include <string>
+
+#include "Check.hpp"
+#include "Film.hpp"
+
+using namespace spt;
+
+// add n samples of luminance around mean to one pixel, in passes of pass samples
+static void addSamples(Film& film, int row, int col, double mean, double sigma, int n, int pass, std::mt19937& rng) {
+  std::normal_distribution<double> d(mean, sigma);
+  for (int k = 0; k < n; k += pass) {
+    Vec3<float> sum(0.f, 0.f, 0.f);
+    double lum = 0.0, lumSq = 0.0;
+    for (int i = k; i < std::min(n, k + pass); i++) {
+      float v = float(d(rng));
+      sum += Vec3<float>(v, v, v);
+      lum += luminance(Vec3<float>(v, v, v));
+      lumSq += double(luminance(Vec3<float>(v, v, v))) * luminance(Vec3<float>(v, v, v));
+    }
+    film.add(row, col, sum, lum, lumSq, std::min(n, k + pass) - k);
+  }
+}
+
+int main() {
+  std::mt19937 rng(5);
+
+  // a bright pixel with little noise: the mean of squares and the squared mean nearly cancel
+  {
+    Film film(2, 1);
+    const int n = 20000;
+    const double sigma = 0.01;
+    addSamples(film, 0, 0, 100.0, sigma, n, 64, rng);
+    double expected = sigma * sigma / n;
+    CHECK_NEAR(film.getVariance(0, 0), expected, expected * 0.1);
+    CHECK(film.getError(0, 0) < 1e-5f);
+
+    // single sample counts as 100% relative error
+    addSamples(film, 0, 1, 2.0, 0.5, 1, 1, rng);
+    CHECK(film.getError(0, 1) > 1e30f);
+  }
+
+  // checkpoint round trip, full and windowed
+  {
+    std::string name = "film_test.sptf";
+    Film film(3, 2, 4, 5, 16, 16);
+    for (int row = 5; row < 7; row++) {
+      for (int col = 4; col < 7; col++) {
+        addSamples(film, row, col, row + col, 0.3, 40, 8, rng);
+      }
+    }
+    CHECK(film.save(name));
+
+    Film same(3, 2, 4, 5, 16, 16);
+    CHECK(same.load(name));
+    Film other(3, 2, 0, 0, 16, 16);
+    CHECK(!other.load(name));
+    Film partial;
+    CHECK(partial.loadPartial(name));
+    CHECK(partial.getOriginX() == 4 && partial.getOriginY() == 5 && partial.getFrameWidth() == 16);
+    for (int row = 5; row < 7; row++) {
+      for (int col = 4; col < 7; col++) {
+        for (const Film* f : {&same, &partial}) {
+          CHECK(f->getCount(row, col) == film.getCount(row, col));
+          CHECK(f->getVariance(row, col) == film.getVariance(row, col));
+          CHECK(f->getPixel(row, col).x == film.getPixel(row, col).x);
+        }
+      }
+    }
+
+    // truncated checkpoints are rejected
+    {
+      std::ifstream in(name, std::ios::binary);
+      std::string bytes((std::istreambuf_iterator<char>(in)), std::istreambuf_iterator<char>());
+      std::ofstream out(name, std::ios::binary | std::ios::trunc);
+      out.write(bytes.data(), bytes.size() - 1);
+    }
+    CHECK(!same.load(name));
+    std::remove(name.c_str());
+  }
+
+  return checkFailures == 0 ? 0 : 1;
+}
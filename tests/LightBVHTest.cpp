@@ -0,0 +1,93 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "Check.hpp"
+#include "LightBVH.hpp"
+
+using namespace spt;
+
+static std::shared_ptr<Triangle> triangle(size_t id, const Vec3<float>& p, float size) {
+  return std::make_shared<Triangle>(id, p, p + Vec3<float>(size, 0.f, 0.f), p + Vec3<float>(0.f, 0.f, size), 0u);
+}
+
+// pmf over all lights sums to one wherever any light contributes, and sample agrees with pmf
+static void checkDistribution(const LightBVH& bvh, size_t lightCount, std::mt19937& rng) {
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+  for (int k = 0; k < 20; k++) {
+    Vec3<float> p(u(rng) * 20 - 10, u(rng) * 20 - 10, u(rng) * 20 - 10);
+    float sum = 0.f;
+    for (uint i = 0; i < lightCount; i++) {
+      sum += bvh.pmf(p, Vec3<float>(0.f, 0.f, 0.f), i);
+    }
+    uint lidx;
+    float prob;
+    if (bvh.sample(p, Vec3<float>(0.f, 0.f, 0.f), u(rng), lidx, prob)) {
+      CHECK_NEAR(sum, 1.f, 1e-3f);
+      CHECK_NEAR(prob, bvh.pmf(p, Vec3<float>(0.f, 0.f, 0.f), lidx), 1e-5f);
+    }
+  }
+}
+
+int main() {
+  std::mt19937 rng(7);
+
+  // coincident centroids used to split one light off per level and overflow the 64-bit trails
+  {
+    std::vector<std::shared_ptr<Triangle>> lights;
+    std::vector<float> powers;
+    for (size_t i = 0; i < 1000; i++) {
+      lights.push_back(triangle(i, Vec3<float>(0.f, 1.f, 0.f), 1.f));
+      powers.push_back(1.f + (i % 3));
+    }
+    LightBVH bvh;
+    bvh.build(lights, powers);
+    CHECK(bvh.getNodeCount() == 2 * lights.size() - 1);
+    checkDistribution(bvh, lights.size(), rng);
+  }
+
+  // one far light and a coincident cluster, ties in the cost go to the median
+  {
+    std::vector<std::shared_ptr<Triangle>> lights;
+    std::vector<float> powers;
+    lights.push_back(triangle(0, Vec3<float>(5.f, 1.f, 0.f), 1.f));
+    powers.push_back(1.f);
+    for (size_t i = 1; i < 300; i++) {
+      lights.push_back(triangle(i, Vec3<float>(-5.f, 1.f, 0.f), 0.5f));
+      powers.push_back(1.f);
+    }
+    LightBVH bvh;
+    bvh.build(lights, powers);
+    checkDistribution(bvh, lights.size(), rng);
+  }
+
+  // scattered lights
+  {
+    std::uniform_real_distribution<float> u(-8.f, 8.f);
+    std::vector<std::shared_ptr<Triangle>> lights;
+    std::vector<float> powers;
+    for (size_t i = 0; i < 500; i++) {
+      lights.push_back(triangle(i, Vec3<float>(u(rng), u(rng), u(rng)), 0.3f));
+      powers.push_back(0.5f + (i % 5));
+    }
+    LightBVH bvh;
+    bvh.build(lights, powers);
+    checkDistribution(bvh, lights.size(), rng);
+  }
+
+  // emitters are two-sided as in the integrator: a point behind the light still samples it
+  {
+    std::vector<std::shared_ptr<Triangle>> lights = {triangle(0, Vec3<float>(0.f, 0.f, 0.f), 1.f),
+                                                     triangle(1, Vec3<float>(3.f, 0.f, 0.f), 1.f)};
+    std::vector<float> powers = {1.f, 1.f};
+    LightBVH bvh;
+    bvh.build(lights, powers);
+    Vec3<float> n = lights[0]->getNormal();
+    Vec3<float> above = Vec3<float>(0.3f, 0.f, 0.3f) + n * 2.f, below = Vec3<float>(0.3f, 0.f, 0.3f) - n * 2.f;
+    CHECK(bvh.pmf(above, Vec3<float>(0.f, 0.f, 0.f), 0) > 0.f);
+    CHECK(bvh.pmf(below, Vec3<float>(0.f, 0.f, 0.f), 0) > 0.f);
+    CHECK_NEAR(bvh.pmf(above, Vec3<float>(0.f, 0.f, 0.f), 0), bvh.pmf(below, Vec3<float>(0.f, 0.f, 0.f), 0), 1e-4f);
+  }
+
+  return checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,53 @@
+#include <memory>
+#include <random>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Check.hpp"
+
+using namespace spt;
+
+int main() {
+  std::mt19937 rng(11);
+  std::uniform_real_distribution<float> u(0.f, 1.f);
+
+  // scattered small triangles, enough for several bvh levels
+  std::vector<std::shared_ptr<Hittable>> objects;
+  for (size_t i = 0; i < 2000; i++) {
+    Vec3<float> p(u(rng) * 20 - 10, u(rng) * 20 - 10, u(rng) * 20 - 10);
+    Vec3<float> a(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f), b(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f);
+    objects.push_back(std::make_shared<Triangle>(i, p, p + a * 2.f, p + b * 2.f, 0u));
+  }
+  auto bvh = BVH::constructBVH(objects, 0, int(objects.size()), 8);
+
+  // batches around the 64-ray lane size, the batched answer must match one ray at a time
+  ShadowBatch batch;
+  for (size_t count : {1, 63, 64, 65, 200}) {
+    batch.clear();
+    for (size_t i = 0; i < count; i++) {
+      Vec3<float> o(u(rng) * 20 - 10, u(rng) * 20 - 10, u(rng) * 20 - 10);
+      Vec3<float> d = normalize(Vec3<float>(u(rng) - 0.5f, u(rng) - 0.5f, u(rng) - 0.5f));
+      batch.add(Ray(o, d), u(rng) * 15.f);
+    }
+    bvh->occluded(batch);
+    CHECK(batch.occluded.size() == count);
+
+    size_t hits = 0;
+    for (size_t i = 0; i < count; i++) {
+      bool expected = bvh->occluded(batch.rays[i], batch.tMaxs[i]);
+      CHECK(bool(batch.occluded[i]) == expected);
+      hits += expected;
+    }
+    if (count == 200) {
+      CHECK(hits > 0 && hits < count);
+    }
+  }
+
+  // a shadow ray stopped short of the light does not hit the light itself
+  Triangle light(0, Vec3<float>(-1.f, 5.f, -1.f), Vec3<float>(1.f, 5.f, -1.f), Vec3<float>(0.f, 5.f, 1.f), 0u);
+  Ray ray(Vec3<float>(0.f, 0.f, 0.f), Vec3<float>(0.f, 1.f, 0.f));
+  CHECK(light.occluded(ray, 5.f + RAY_OFFSET));
+  CHECK(!light.occluded(ray, 5.f - RAY_OFFSET));
+
+  return checkFailures == 0 ? 0 : 1;
+}
@@ -0,0 +1,137 @@
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "BVH.hpp"
+#include "Check.hpp"
+#include "Material.hpp"
+#include "SceneFile.hpp"
+#include "Triangle.hpp"
+
+using namespace spt;
+
+// the arrays of a two-triangle scene: a root over one leaf per triangle
+struct Scene {
+  std::vector<Material> materials{Material().unlinked()};
+  std::vector<std::string> materialNames{"white"}, textureNames{""};
+  std::vector<TriangleRecord> triangles;
+  std::vector<BVHNodeRecord> nodes;
+  std::vector<uint32_t> objectIds{0, 1}, lights{1};
+
+  Scene() {
+    for (uint32_t i = 0; i < 2; i++) {
+      TriangleRecord t = {};
+      t.v[0] = Vec3<float>(float(i), 0.f, 0.f);
+      t.v[1] = Vec3<float>(float(i) + 1.f, 0.f, 0.f);
+      t.v[2] = Vec3<float>(float(i), 1.f, 0.f);
+      t.normal = Vec3<float>(0.f, 0.f, 1.f);
+      t.mtlId = 0;
+      triangles.push_back(t);
+    }
+    Vec3<float> lo(0.f, 0.f, 0.f), hi(2.f, 1.f, 0.f);
+    nodes.push_back({lo, hi, 2, 0, 1, 2});
+    nodes.push_back({lo, hi, 1, 1, 0, 1});
+    nodes.push_back({lo, hi, 1, 1, 1, 2});
+  }
+};
+
+static bool write(const std::string& name, const Scene& scene) {
+  SceneWriter writer;
+  if (!writer.open(name)) {
+    return false;
+  }
+  SceneHeader& header = writer.getHeader();
+  writer.addStrings(header.config, {"<scene></scene>"});
+  writer.addStrings(header.dir, {"."});
+  writer.add(header.materials, scene.materials);
+  writer.addStrings(header.materialNames, scene.materialNames);
+  writer.addStrings(header.textureNames, scene.textureNames);
+  writer.add(header.triangles, scene.triangles);
+  writer.add(header.nodes, scene.nodes);
+  writer.add(header.objectIds, scene.objectIds);
+  writer.add(header.lights, scene.lights);
+  return writer.close();
+}
+
+// write the scene after edit, then rewrite the file bytes with patch
+static bool opens(const std::string& name, const std::function<void(Scene&)>& edit,
+                  const std::function<void(std::string&)>& patch = nullptr) {
+  Scene scene;
+  edit(scene);
+  if (!write(name, scene)) {
+    return false;
+  }
+  if (patch) {
+    std::string bytes;
+    {
+      std::ifstream in(name, std::ios::binary);
+      bytes.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    patch(bytes);
+    std::ofstream out(name, std::ios::binary | std::ios::trunc);
+    out.write(bytes.data(), bytes.size());
+  }
+  SceneFile file;
+  return file.open(name);
+}
+
+int main() {
+  std::string name = "scenefile_test.sptc";
+  auto none = [](Scene&) {};
+
+  // a valid scene opens and reads back
+  CHECK(write(name, Scene()));
+  {
+    SceneFile file;
+    CHECK(file.open(name));
+    const SceneHeader& header = file.getHeader();
+    CHECK(header.triangles.count == 2 && header.nodes.count == 3 && header.lights.count == 1);
+    CHECK(file.getStrings(header.materialNames) == std::vector<std::string>{"white"});
+    CHECK(file.getStrings(header.config) == std::vector<std::string>{"<scene></scene>"});
+    CHECK(file.get<TriangleRecord>(header.triangles)[1].v[0].x == 1.f);
+    CHECK(file.get<uint32_t>(header.objectIds)[1] == 1);
+  }
+
+  // foreign or corrupt headers
+  CHECK(!opens(name, none, [](std::string& b) { b[0] = 'X'; }));
+  CHECK(!opens(name, none, [](std::string& b) { b[offsetof(SceneHeader, version)]++; }));
+  CHECK(!opens(name, none, [](std::string& b) { b[offsetof(SceneHeader, triangleSize)]++; }));
+  CHECK(!opens(name, none, [](std::string& b) { b.resize(sizeof(SceneHeader) - 1); }));
+
+  // sections past the end of a truncated file
+  CHECK(!opens(name, none, [](std::string& b) { b.resize(b.size() - 1); }));
+  // a misaligned section
+  CHECK(!opens(name, none, [](std::string& b) {
+    SceneHeader header;
+    std::memcpy(&header, b.data(), sizeof(header));
+    header.triangles.offset += 4;
+    std::memcpy(&b[0], &header, sizeof(header));
+  }));
+
+  // bvh children must come after their parent and stay in range
+  CHECK(!opens(name, [](Scene& s) { s.nodes.clear(); }));
+  CHECK(!opens(name, [](Scene& s) { s.nodes[0].end = 3; }));
+  CHECK(!opens(name, [](Scene& s) { s.nodes[0].begin = 0; }));
+  CHECK(!opens(name, [](Scene& s) { s.nodes[2].end = 3; }));
+  CHECK(!opens(name, [](Scene& s) { s.nodes[2].begin = 2, s.nodes[2].end = 1; }));
+
+  // ids must refer to existing triangles and materials
+  CHECK(!opens(name, [](Scene& s) { s.objectIds[1] = 2; }));
+  CHECK(!opens(name, [](Scene& s) { s.lights[0] = 2; }));
+  CHECK(!opens(name, [](Scene& s) { s.triangles[0].mtlId = 1; }));
+  CHECK(!opens(name, [](Scene& s) { s.textureNames.clear(); }));
+
+  // unterminated strings
+  CHECK(!opens(name, none, [](std::string& b) {
+    SceneHeader header;
+    std::memcpy(&header, b.data(), sizeof(header));
+    b[header.config.offset + header.config.count - 1] = '>';
+  }));
+
+  std::remove(name.c_str());
+  return checkFailures == 0 ? 0 : 1;
+}